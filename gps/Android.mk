@@ -5,6 +5,12 @@ GNSS_CFLAGS := \
     -Werror \
     -Wno-undefined-bool-conversion
 
+# Compile LOC_LOGD and LOC_LOGV out of user builds, see LOC_LOG_COMPILE_LEVEL
+# in utils/log_util.h; matches GNSS_CFLAGS and GNSS_PRODUCT_VARIABLES in Android.bp
+ifeq ($(TARGET_BUILD_VARIANT),user)
+GNSS_CFLAGS += -DLOC_LOG_COMPILE_LEVEL=3
+endif
+
 GNSS_HIDL_VERSION = 2.1
 
 GNSS_HIDL_LEGACY_MEASURMENTS_TARGET_LIST += msm8937
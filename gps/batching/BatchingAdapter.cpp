@@ -39,7 +39,7 @@ using namespace loc_core;
 BatchingAdapter::BatchingAdapter() :
     LocAdapterBase(0,
                    LocContext::getLocContext(LocContext::mLocationHalName),
-                   false, nullptr, true),
+                   false, nullptr, true, "BatchingAdapter"),
     mOngoingTripDistance(0),
     mOngoingTripTBFInterval(0),
     mTripWithOngoingTBFDropped(false),
@@ -602,6 +602,9 @@ BatchingAdapter::reportLocationsEvent(const Location* locations, size_t count,
         Location* mLocations;
         size_t mCount;
         BatchingMode mBatchingMode;
+
+        LOC_MSG_POOL(MsgReportLocations, 4)
+
         inline MsgReportLocations(BatchingAdapter& adapter,
                                   const Location* locations,
                                   size_t count,
@@ -624,6 +627,9 @@ BatchingAdapter::reportLocationsEvent(const Location* locations, size_t count,
             if (nullptr != mLocations)
                 delete[] mLocations;
         }
+        inline virtual LocMsgLane getLane() const override {
+            return LOC_MSG_LANE_POSITION;
+        }
         inline virtual void proc() const {
             mAdapter.reportLocations(mLocations, mCount, mBatchingMode);
         }
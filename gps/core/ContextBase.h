@@ -149,6 +149,12 @@ public:
     }
 
     inline const MsgTask* getMsgTask() { return mMsgTask; }
+    // MsgTask for an adapter to run its msgs on. Adapters asking for the same
+    // strandName share one; nullptr, or a context without strands, gives the
+    // context MsgTask.
+    inline virtual const MsgTask* getAdapterMsgTask(const char* /*strandName*/) {
+        return mMsgTask;
+    }
     inline LocApiBase* getLocApi() { return mLocApi; }
     inline LocApiProxyBase* getLocApiProxy() { return mLocApiProxy; }
     inline bool hasAgpsExtendedCapabilities() { return mLBSProxy->hasAgpsExtendedCapabilities(); }
@@ -316,6 +322,8 @@ public:
 struct LocApiResponse: LocMsg {
     private:
         ContextBase& mContext;
+        // strand the request was made on, replies go back there
+        const MsgTask* mSender;
         std::function<void (LocationError err)> mProcImpl;
         inline virtual void proc() const {
             mProcImpl(mLocationError);
@@ -325,17 +333,23 @@ struct LocApiResponse: LocMsg {
     public:
         inline LocApiResponse(ContextBase& context,
                               std::function<void (LocationError err)> procImpl ) :
-                              mContext(context), mProcImpl(procImpl) {}
+                              mContext(context), mSender(MsgTask::getCurrentStrand()),
+                              mProcImpl(procImpl) {}
 
         void returnToSender(const LocationError err) {
             mLocationError = err;
-            mContext.sendMsg(this);
+            if (nullptr != mSender) {
+                mSender->sendMsg(this);
+            } else {
+                mContext.sendMsg(this);
+            }
         }
 };
 
 struct LocApiCollectiveResponse: LocMsg {
     private:
         ContextBase& mContext;
+        const MsgTask* mSender;
         std::function<void (std::vector<LocationError> errs)> mProcImpl;
         inline virtual void proc() const {
             mProcImpl(mLocationErrors);
@@ -345,13 +359,18 @@ struct LocApiCollectiveResponse: LocMsg {
     public:
         inline LocApiCollectiveResponse(ContextBase& context,
                               std::function<void (std::vector<LocationError> errs)> procImpl ) :
-                              mContext(context), mProcImpl(procImpl) {}
+                              mContext(context), mSender(MsgTask::getCurrentStrand()),
+                              mProcImpl(procImpl) {}
         inline virtual ~LocApiCollectiveResponse() {
         }
 
         void returnToSender(std::vector<LocationError>& errs) {
             mLocationErrors = errs;
-            mContext.sendMsg(this);
+            if (nullptr != mSender) {
+                mSender->sendMsg(this);
+            } else {
+                mContext.sendMsg(this);
+            }
         }
 };
 
@@ -360,6 +379,7 @@ template <typename DATA>
 struct LocApiResponseData: LocMsg {
     private:
         ContextBase& mContext;
+        const MsgTask* mSender;
         std::function<void (LocationError err, DATA data)> mProcImpl;
         inline virtual void proc() const {
             mProcImpl(mLocationError, mData);
@@ -370,12 +390,17 @@ struct LocApiResponseData: LocMsg {
     public:
         inline LocApiResponseData(ContextBase& context,
                               std::function<void (LocationError err, DATA data)> procImpl ) :
-                              mContext(context), mProcImpl(procImpl) {}
+                              mContext(context), mSender(MsgTask::getCurrentStrand()),
+                              mProcImpl(procImpl) {}
 
         void returnToSender(const LocationError err, const DATA data) {
             mLocationError = err;
             mData = data;
-            mContext.sendMsg(this);
+            if (nullptr != mSender) {
+                mSender->sendMsg(this);
+            } else {
+                mContext.sendMsg(this);
+            }
         }
 };
 
@@ -44,11 +44,11 @@ namespace loc_core {
 LocAdapterBase::LocAdapterBase(const LOC_API_ADAPTER_EVENT_MASK_T mask,
                                ContextBase* context, bool isMaster,
                                LocAdapterProxyBase *adapterProxyBase,
-                               bool waitForDoneInit) :
+                               bool waitForDoneInit, const char* strandName) :
     mIsMaster(isMaster),
     mIsEngineCapabilitiesKnown(ContextBase::sIsEngineCapabilitiesKnown),
     mEvtMask(mask), mContext(context), mLocApi(context->getLocApi()),
-    mLocAdapterProxyBase(adapterProxyBase), mMsgTask(context->getMsgTask())
+    mLocAdapterProxyBase(adapterProxyBase), mMsgTask(context->getAdapterMsgTask(strandName))
 {
     LOC_LOGd("waitForDoneInit: %d", waitForDoneInit);
     if (!waitForDoneInit) {
@@ -101,10 +101,16 @@ public:
     // waitForDoneInit to *TRUE* to delay handleEngineUpEvent to get called
     // until when the child adapter finishes its initialization and notify
     // LocAdapterBase via doneInit method.
+    //
+    // strandName names the strand the adapter msgs run on, see
+    // ContextBase::getAdapterMsgTask(). Adapters relying on the order of their
+    // msgs relative to another adapter's must pass the same name, or NULL to
+    // share the context MsgTask.
     LocAdapterBase(const LOC_API_ADAPTER_EVENT_MASK_T mask,
                    ContextBase* context, bool isMaster = false,
                    LocAdapterProxyBase *adapterProxyBase = NULL,
-                   bool waitForDoneInit = false);
+                   bool waitForDoneInit = false,
+                   const char* strandName = NULL);
 
     inline void doneInit() {
         if (!mAdapterAdded) {
@@ -35,10 +35,13 @@
 #include <msg_q.h>
 #include <log_util.h>
 #include <loc_log.h>
+#include <loc_cfg.h>
 
 namespace loc_core {
 
 const MsgTask* LocContext::mMsgTask = NULL;
+LocStrandPool* LocContext::mStrandPool = NULL;
+std::map<std::string, const MsgTask*> LocContext::mStrands;
 ContextBase* LocContext::mContext = NULL;
 // the name must be shorter than 15 chars
 const char* LocContext::mLocationHalName = "Loc_hal_worker";
@@ -50,14 +53,88 @@ const char* LocContext::mLBSLibName = "liblbs_core.so.1";
 
 pthread_mutex_t LocContext::mGetLocContextMutex = PTHREAD_MUTEX_INITIALIZER;
 
+// MsgTask settings from gps.conf, shared by the context MsgTask and the
+// adapter strands
+static uint32_t sMsgQEngine = eMSG_Q_ENGINE_LINKED_LIST;
+static uint32_t sMsgQRingSize = 0;
+static uint32_t sMsgQPriorityLanes = 0;
+static uint32_t sMsgQLaneDepths[LOC_MSG_LANE_MAX] = {};
+static uint32_t sMsgQStarvationLimit = 0;
+static uint32_t sMsgQMaxBatch = 1;
+static uint32_t sMsgQCoalesce = 0;
+static uint32_t sMsgTaskStats = 0;
+static uint32_t sMsgTaskStatsLogInterval = 0;
+static uint32_t sAdapterStrandThreads = 0;
+
+static void configureMsgTask(MsgTask* msgTask)
+{
+    if (sMsgQPriorityLanes) {
+        msgTask->enablePriorityLanes(sMsgQLaneDepths, sMsgQStarvationLimit);
+    }
+    if (sMsgQCoalesce) {
+        msgTask->enableCoalescing();
+    }
+    if (sMsgTaskStats) {
+        msgTask->enableStats(sMsgTaskStatsLogInterval);
+    }
+}
+
 const MsgTask* LocContext::getMsgTask(const char* name)
 {
     if (NULL == mMsgTask) {
-        mMsgTask = new MsgTask(name);
+        const loc_param_s_type msg_q_conf_param_table[] =
+        {
+            {"MSG_Q_ENGINE",              &sMsgQEngine,                               NULL, 'n'},
+            {"MSG_Q_RING_SIZE",           &sMsgQRingSize,                             NULL, 'n'},
+            {"MSG_Q_PRIORITY_LANES",      &sMsgQPriorityLanes,                        NULL, 'n'},
+            {"MSG_Q_POSITION_LANE_DEPTH", &sMsgQLaneDepths[LOC_MSG_LANE_POSITION],    NULL, 'n'},
+            {"MSG_Q_BULK_LANE_DEPTH",     &sMsgQLaneDepths[LOC_MSG_LANE_BULK],        NULL, 'n'},
+            {"MSG_Q_STARVATION_LIMIT",    &sMsgQStarvationLimit,                      NULL, 'n'},
+            {"MSG_Q_MAX_BATCH",           &sMsgQMaxBatch,                             NULL, 'n'},
+            {"MSG_Q_COALESCE",            &sMsgQCoalesce,                             NULL, 'n'},
+            {"MSG_TASK_STATS",            &sMsgTaskStats,                             NULL, 'n'},
+            {"MSG_TASK_STATS_LOG_INTERVAL", &sMsgTaskStatsLogInterval,                NULL, 'n'},
+            {"ADAPTER_STRAND_THREADS",    &sAdapterStrandThreads,                     NULL, 'n'},
+        };
+        UTIL_READ_CONF(LOC_PATH_GPS_CONF, msg_q_conf_param_table);
+        LOC_LOGd("msgQEngine %u msgQRingSize %u msgQPriorityLanes %u "
+                 "lane depths %u %u starvation limit %u max batch %u strand threads %u",
+                 sMsgQEngine, sMsgQRingSize, sMsgQPriorityLanes,
+                 sMsgQLaneDepths[LOC_MSG_LANE_POSITION], sMsgQLaneDepths[LOC_MSG_LANE_BULK],
+                 sMsgQStarvationLimit, sMsgQMaxBatch, sAdapterStrandThreads);
+        const LocThreadAttr threadAttr = LocThreadAttr::fromConf("MSG_TASK");
+        MsgTask* msgTask = new MsgTask(name, (msg_q_engine_type)sMsgQEngine, sMsgQRingSize,
+                                       sMsgQMaxBatch, threadAttr);
+        configureMsgTask(msgTask);
+        mMsgTask = msgTask;
+        if (sAdapterStrandThreads > 0) {
+            mStrandPool = new LocStrandPool("Loc_strand", sAdapterStrandThreads, threadAttr);
+        }
     }
     return mMsgTask;
 }
 
+const MsgTask* LocContext::getAdapterMsgTask(const char* strandName)
+{
+    const MsgTask* msgTask = mMsgTask;
+    if (NULL != strandName && NULL != mStrandPool) {
+        pthread_mutex_lock(&LocContext::mGetLocContextMutex);
+        auto it = mStrands.find(strandName);
+        if (it != mStrands.end()) {
+            msgTask = it->second;
+        } else {
+            MsgTask* strand = new MsgTask(*mStrandPool, (msg_q_engine_type)sMsgQEngine,
+                                          sMsgQRingSize, sMsgQMaxBatch);
+            configureMsgTask(strand);
+            mStrands[strandName] = strand;
+            msgTask = strand;
+            LOC_LOGd("new strand %s", strandName);
+        }
+        pthread_mutex_unlock(&LocContext::mGetLocContextMutex);
+    }
+    return msgTask;
+}
+
 ContextBase* LocContext::getLocContext(const char* name)
 {
     pthread_mutex_lock(&LocContext::mGetLocContextMutex);
@@ -32,12 +32,18 @@
 #include <stdbool.h>
 #include <ctype.h>
 #include <dlfcn.h>
+#include <map>
+#include <string>
 #include <ContextBase.h>
+#include <LocStrandPool.h>
 
 namespace loc_core {
 
 class LocContext : public ContextBase {
     static const MsgTask* mMsgTask;
+    // adapter strands by name, if ADAPTER_STRAND_THREADS is set in gps.conf
+    static LocStrandPool* mStrandPool;
+    static std::map<std::string, const MsgTask*> mStrands;
     static ContextBase* mContext;
     static const MsgTask* getMsgTask(const char* name);
     static pthread_mutex_t mGetLocContextMutex;
@@ -52,6 +58,8 @@ public:
 
     static ContextBase* getLocContext(const char* name);
 
+    virtual const MsgTask* getAdapterMsgTask(const char* strandName) override;
+
     static void injectFeatureConfig(ContextBase *context);
 };
 
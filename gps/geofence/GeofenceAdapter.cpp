@@ -38,7 +38,7 @@ using namespace loc_core;
 GeofenceAdapter::GeofenceAdapter() :
     LocAdapterBase(0,
                    LocContext::getLocContext(LocContext::mLocationHalName),
-                   true /*isMaster*/, nullptr, true)
+                   true /*isMaster*/, nullptr, true, "GeofenceAdapter")
 {
     LOC_LOGD("%s]: Constructor", __func__);
 
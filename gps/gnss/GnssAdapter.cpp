@@ -92,7 +92,7 @@ inline void GnssReportLoggerUtil::log(const GnssLatencyInfo& gnssLatencyMeasInfo
 GnssAdapter::GnssAdapter() :
     LocAdapterBase(0,
                    LocContext::getLocContext(LocContext::mLocationHalName),
-                   true, nullptr, true),
+                   true, nullptr, true, "GnssAdapter"),
     mEngHubProxy(new EngineHubProxyBase()),
     mNHzNeeded(false),
     mSPEAlreadyRunningAtHighestInterval(false),
@@ -3724,6 +3724,8 @@ GnssAdapter::reportPositionEvent(const UlpLocation& ulpLocation,
         mutable GnssDataNotification mDataNotify;
         int mMsInWeek;
 
+        LOC_MSG_POOL(MsgReportSPEPosition, 8)
+
         inline MsgReportSPEPosition(GnssAdapter& adapter,
                                     const UlpLocation& ulpLocation,
                                     const GpsLocationExtended& locationExtended,
@@ -3739,6 +3741,9 @@ GnssAdapter::reportPositionEvent(const UlpLocation& ulpLocation,
             mTechMask(techMask),
             mDataNotify(dataNotify),
             mMsInWeek(msInWeek) {}
+        inline virtual LocMsgLane getLane() const override {
+            return LOC_MSG_LANE_POSITION;
+        }
         inline virtual void proc() const {
             if (mAdapter.mTimeBasedTrackingSessions.empty() &&
                 mAdapter.mDistanceBasedTrackingSessions.empty()) {
@@ -3822,6 +3827,9 @@ GnssAdapter::reportEnginePositionsEvent(unsigned int count,
                 memcpy(mEngLocInfo, locationArr, sizeof(EngineLocationInfo)*mCount);
             }
         }
+        inline virtual LocMsgLane getLane() const override {
+            return LOC_MSG_LANE_POSITION;
+        }
         inline virtual void proc() const {
             mAdapter.reportEnginePositions(mCount, mEngLocInfo);
         }
@@ -4066,6 +4074,9 @@ GnssAdapter::reportLatencyInfoEvent(const GnssLatencyInfo& gnssLatencyInfo)
             const GnssLatencyInfo& gnssLatencyInfo) :
             mAdapter(adapter),
             mGnssLatencyInfo(gnssLatencyInfo) {}
+        inline virtual LocMsgLane getLane() const override {
+            return LOC_MSG_LANE_BULK;
+        }
         inline virtual void proc() const {
             mAdapter.mGnssLatencyInfoQueue.push(mGnssLatencyInfo);
             LOC_LOGv("mGnssLatencyInfoQueue.size after push=%zu",
@@ -4152,6 +4163,14 @@ GnssAdapter::reportSvEvent(const GnssSvNotification& svNotify,
             LocMsg(),
             mAdapter(adapter),
             mSvNotify(svNotify) {}
+        inline virtual LocMsgLane getLane() const override {
+            return LOC_MSG_LANE_BULK;
+        }
+        // a newer SV report supersedes a still queued one
+        inline virtual uintptr_t getCoalesceKey() const override {
+            static const char sKeyTag = 0;
+            return (uintptr_t)&sKeyTag;
+        }
         inline virtual void proc() const {
             mAdapter.reportSv((GnssSvNotification&)mSvNotify);
         }
@@ -4333,12 +4352,17 @@ GnssAdapter::reportNmeaEvent(const char* nmea, size_t length)
         GnssAdapter& mAdapter;
         const char* mNmea;
         size_t mLength;
+        // single sentences are kept inline, longer reports go to the heap
+        char mNmeaBuf[NMEA_SENTENCE_MAX_LENGTH + 1];
+
+        LOC_MSG_POOL(MsgReportNmea, 32)
+
         inline MsgReportNmea(GnssAdapter& adapter,
                              const char* nmea,
                              size_t length) :
             LocMsg(),
             mAdapter(adapter),
-            mNmea(new char[length+1]),
+            mNmea((length < sizeof(mNmeaBuf)) ? mNmeaBuf : new char[length+1]),
             mLength(length) {
                 if (mNmea == nullptr) {
                     LOC_LOGE("%s] new allocation failed, fatal error.", __func__);
@@ -4348,7 +4372,30 @@ GnssAdapter::reportNmeaEvent(const char* nmea, size_t length)
             }
         inline virtual ~MsgReportNmea()
         {
-            delete[] mNmea;
+            if (mNmea != mNmeaBuf) {
+                delete[] mNmea;
+            }
+        }
+        inline virtual LocMsgLane getLane() const override {
+            return LOC_MSG_LANE_BULK;
+        }
+        // Only once-per-fix sentences are coalesced, keyed by talker and
+        // sentence id. Multi part (e.g. GSV) and proprietary sentences, which
+        // SystemStatus also consumes, are always delivered.
+        inline virtual uintptr_t getCoalesceKey() const override {
+            static const char* const sSentences[] = { "GGA", "RMC", "VTG", "GNS" };
+            static const size_t sNumSentences = sizeof(sSentences) / sizeof(sSentences[0]);
+            static const char sKeyTags[sNumSentences][26 * 26] = {};
+            if (nullptr == mNmea || mLength < 7 || '$' != mNmea[0] || ',' != mNmea[6] ||
+                mNmea[1] < 'A' || mNmea[1] > 'Z' || mNmea[2] < 'A' || mNmea[2] > 'Z') {
+                return 0;
+            }
+            for (size_t i = 0; i < sNumSentences; i++) {
+                if (0 == strncmp(mNmea + 3, sSentences[i], 3)) {
+                    return (uintptr_t)&sKeyTags[i][(mNmea[1] - 'A') * 26 + (mNmea[2] - 'A')];
+                }
+            }
+            return 0;
         }
         inline virtual void proc() const {
             // extract bug report info - this returns true if consumed by systemstatus
@@ -4409,6 +4456,13 @@ GnssAdapter::reportDataEvent(const GnssDataNotification& dataNotify,
             mDataNotify(dataNotify),
             mMsInWeek(msInWeek) {
         }
+        inline virtual LocMsgLane getLane() const override {
+            return LOC_MSG_LANE_BULK;
+        }
+        inline virtual uintptr_t getCoalesceKey() const override {
+            static const char sKeyTag = 0;
+            return (uintptr_t)&sKeyTag;
+        }
         inline virtual void proc() const {
             if (mMsInWeek >= 0) {
                 mAdapter.getDataInformation((GnssDataNotification&)mDataNotify,
@@ -4731,6 +4785,9 @@ GnssAdapter::reportGnssMeasurementsEvent(const GnssMeasurements& gnssMeasurement
             GnssAdapter& mAdapter;
             GnssMeasurements mGnssMeasurements;
             GnssMeasurementsNotification mMeasurementsNotify;
+
+            LOC_MSG_POOL(MsgReportGnssMeasurementData, 4)
+
             inline MsgReportGnssMeasurementData(GnssAdapter& adapter,
                                                 const GnssMeasurements& gnssMeasurements,
                                                 int msInWeek) :
@@ -4741,6 +4798,9 @@ GnssAdapter::reportGnssMeasurementsEvent(const GnssMeasurements& gnssMeasurement
                     mAdapter.getAgcInformation(mMeasurementsNotify, msInWeek);
                 }
             }
+            inline virtual LocMsgLane getLane() const override {
+                return LOC_MSG_LANE_BULK;
+            }
             inline virtual void proc() const {
                 mAdapter.reportGnssMeasurementData(mMeasurementsNotify);
             }
@@ -5626,6 +5686,18 @@ bool GnssAdapter::getDebugReport(GnssDebugReport& r)
     convertSatelliteInfo(r.mSatelliteInfo, GNSS_SV_TYPE_NAVIC, reports);
     LOC_LOGV("getDebugReport - satellite=%zu", r.mSatelliteInfo.size());
 
+    // adapter thread stats, if MSG_TASK_STATS is enabled in gps.conf
+    if (mMsgTask->statsEnabled()) {
+        std::string msgTaskStats;
+        mMsgTask->dumpStats(msgTaskStats);
+        size_t start = 0;
+        size_t end = 0;
+        while ((end = msgTaskStats.find('\n', start)) != std::string::npos) {
+            LOC_LOGi("%.*s", (int)(end - start), msgTaskStats.c_str() + start);
+            start = end + 1;
+        }
+    }
+
     return true;
 }
 
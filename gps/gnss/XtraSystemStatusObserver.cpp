@@ -109,14 +109,16 @@ XtraSystemStatusObserver::XtraSystemStatusObserver(IOsObserver* sysStatObs,
         mGpsLock(-1), mConnections(~0), mXtraThrottle(true),
         mReqStatusReceived(false),
         mIsConnectivityStatusKnown(false),
-        mSender(LocIpc::getLocIpcLocalSender(LOC_IPC_XTRA)),
-        mDelayLocTimer(*mSender) {
+        mSender(LocIpc::getLocIpcLocalSender(LOC_IPC_XTRA)) {
     subscribe(true);
     auto recver = LocIpc::getLocIpcLocalRecver(
             make_shared<XtraIpcListener>(sysStatObs, msgTask, *this),
             LOC_IPC_HAL);
     mIpc.startNonBlockingListening(recver);
-    mDelayLocTimer.start(100 /*.1 sec*/,  false);
+    shared_ptr<LocIpcSender> sender(mSender);
+    mMsgTask->sendMsgDelayed([sender] {
+        LocIpc::send(*sender, (const uint8_t*)"halinit", sizeof("halinit"));
+    }, 100 /*.1 sec*/);
 }
 
 bool XtraSystemStatusObserver::updateLockStatus(GnssConfigGpsLock lock) {
@@ -98,15 +98,6 @@ private:
     bool mIsConnectivityStatusKnown;
     shared_ptr<LocIpcSender> mSender;
     string mNtripParamsString;
-
-    class DelayLocTimer : public LocTimer {
-        LocIpcSender& mSender;
-    public:
-        DelayLocTimer(LocIpcSender& sender) : mSender(sender) {}
-        void timeOutCallback() override {
-            LocIpc::send(mSender, (const uint8_t*)"halinit", sizeof("halinit"));
-        }
-    } mDelayLocTimer;
 };
 
 #endif
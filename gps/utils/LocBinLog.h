@@ -0,0 +1,169 @@
+/* Copyright (c) 2020 The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef LOC_BIN_LOG_H
+#define LOC_BIN_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <type_traits>
+#include <log_util.h>
+
+// log_util.h may be included in extern "C" blocks
+extern "C++" {
+namespace loc_util {
+
+/*
+Binary log lines, for LOG_BUFFER_ENABLED = 2: instead of formatting a line
+into the log buffer, LOC_LOGx records the format string and its arguments,
+packed as type tagged values. Lines are only formatted when the log buffer
+is dumped. The format must be a string literal, which all LOC_LOGx formats
+are; string arguments are copied.
+
+Arguments are checked at compile time: only those printf can print, i.e.
+integers, enums, floating point numbers, C strings and pointers, compile.
+*/
+
+enum LocBinLogType : uint8_t {
+    LOC_BIN_LOG_INT,        // signed integer of the argument's size
+    LOC_BIN_LOG_UINT,       // unsigned integer of the argument's size
+    LOC_BIN_LOG_DOUBLE,     // double
+    LOC_BIN_LOG_PTR,        // uint64_t
+    LOC_BIN_LOG_STR,        // uint16_t length, then the chars, no '\0'
+};
+
+// A value is packed as a tag byte, the LocBinLogType in the low 4 bits and
+// the size in bytes of the value that follows in the high 4 bits (0 for
+// strings), then the value. Integers keep the size they are passed to printf
+// with, i.e. those smaller than int are promoted to int, so that they print
+// at their own width.
+inline uint8_t locBinLogTag(LocBinLogType type, size_t size) {
+    return (uint8_t)(type | (size << 4));
+}
+inline LocBinLogType locBinLogType(uint8_t tag) { return (LocBinLogType)(tag & 0xf); }
+inline uint32_t locBinLogSize(uint8_t tag) { return tag >> 4; }
+
+// Packs arguments into buf; those past the end of buf are dropped, and
+// strings cut short.
+class LocBinLogWriter {
+    char* mPos;
+    char* const mEnd;
+
+    inline void putValue(LocBinLogType type, const void* value, size_t size) {
+        if (mEnd - mPos >= (ptrdiff_t)(1 + size)) {
+            *mPos++ = locBinLogTag(type, size);
+            memcpy(mPos, value, size);
+            mPos += size;
+        } else {
+            mPos = mEnd;
+        }
+    }
+    template <typename T>
+    inline typename std::enable_if<std::is_integral<T>::value && (sizeof(T) < sizeof(int))>::type
+            put(T value) {
+        int v = value;
+        putValue(LOC_BIN_LOG_INT, &v, sizeof(v));
+    }
+    template <typename T>
+    inline typename std::enable_if<std::is_integral<T>::value && (sizeof(T) >= sizeof(int))>::type
+            put(T value) {
+        putValue(std::is_signed<T>::value ? LOC_BIN_LOG_INT : LOC_BIN_LOG_UINT,
+                 &value, sizeof(value));
+    }
+    template <typename T>
+    inline typename std::enable_if<std::is_enum<T>::value>::type put(T value) {
+        put(static_cast<typename std::underlying_type<T>::type>(value));
+    }
+    template <typename T>
+    inline typename std::enable_if<std::is_floating_point<T>::value>::type put(T value) {
+        double v = value;
+        putValue(LOC_BIN_LOG_DOUBLE, &v, sizeof(v));
+    }
+    template <typename T>
+    inline typename std::enable_if<std::is_pointer<T>::value || std::is_null_pointer<T>::value>::type
+            put(T value) {
+        uint64_t v = (uintptr_t)value;
+        putValue(LOC_BIN_LOG_PTR, &v, sizeof(v));
+    }
+    // reads no more than maxLen chars, nor more than fit
+    inline void putStr(const char* value, size_t maxLen) {
+        if (mEnd - mPos >= (ptrdiff_t)(1 + sizeof(uint16_t))) {
+            size_t room = std::min({ (size_t)(mEnd - mPos) - 1 - sizeof(uint16_t),
+                                     (size_t)UINT16_MAX, maxLen });
+            size_t len = (nullptr == value) ? 0 : strnlen(value, room);
+            uint16_t l = len;
+            *mPos++ = locBinLogTag(LOC_BIN_LOG_STR, 0);
+            memcpy(mPos, &l, sizeof(l));
+            memcpy(mPos + sizeof(l), value, len);
+            mPos += sizeof(l) + len;
+        } else {
+            mPos = mEnd;
+        }
+    }
+    inline void put(const char* value) { putStr(value, UINT16_MAX); }
+    inline void put(char* value) { putStr(value, UINT16_MAX); }
+    // a char array is read up to its size, it need not be terminated
+    template <size_t N>
+    inline void putArg(const char (&value)[N]) { putStr(value, N); }
+    template <typename T>
+    inline void putArg(const T& value) { put((typename std::decay<T>::type)value); }
+public:
+    inline LocBinLogWriter(char* buf, size_t size) : mPos(buf), mEnd(buf + size) {}
+    inline void putAll() {}
+    template <typename T, typename... Rest>
+    inline void putAll(const T& value, const Rest&... rest) {
+        static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value ||
+                      std::is_pointer<typename std::decay<T>::type>::value ||
+                      std::is_null_pointer<T>::value,
+                      "log arguments must be numbers, C strings or pointers");
+        putArg(value);
+        putAll(rest...);
+    }
+    inline size_t getSize(const char* buf) const { return mPos - buf; }
+};
+
+// adds a binary line to the log buffer; args as packed by LocBinLogWriter
+void log_buffer_insert_binary(int level, const char* tag, const char* format,
+                              const char* args, uint32_t len);
+
+template <typename... Args>
+inline void log_buffer_insert_args(int level, const char* tag, const char* format,
+                                   const Args&... args) {
+    char buf[LOGGING_BUFFER_MAX_LEN];
+    LocBinLogWriter writer(buf, sizeof(buf));
+    writer.putAll(args...);
+    log_buffer_insert_binary(level, tag, format, buf, writer.getSize(buf));
+}
+
+} // namespace loc_util
+} // extern "C++"
+
+#endif // LOC_BIN_LOG_H
@@ -30,13 +30,24 @@
 #define __LOC_HEAP__
 
 #include <stddef.h>
+#include <stdint.h>
 #include <string.h>
+#include <vector>
 
 namespace loc_util {
 
 // abstract class to be implemented by client to provide a rankable class
 class LocRankable {
+    friend class LocHeap;
+    // position in the LocHeap holding this obj, kNotInHeap if none. An obj
+    // can be in only one heap at a time.
+    size_t mHeapIndex;
 public:
+    static const size_t kNotInHeap = (size_t)-1;
+
+    inline LocRankable() : mHeapIndex(kNotInHeap) {}
+    inline LocRankable(const LocRankable&) : mHeapIndex(kNotInHeap) {}
+    inline LocRankable& operator=(const LocRankable&) { return *this; }
     virtual inline ~LocRankable() {}
 
     // method to rank objects of such type for sorting purposes.
@@ -50,45 +61,55 @@ public:
     inline bool outRanks(LocRankable& rankable) { return ranks(rankable) > 0; }
 };
 
-// opaque class to provide service implementation.
-class LocHeapNode;
-
-// a heap whose left and right children are not sorted. It is sorted only vertically,
-// i.e. parent always ranks higher than children, if they exist. Ranking algorithm is
-// implemented in Rankable. The reason that there is no sort between children is to
-// help beter balance the tree with lower cost. When a node is pushed to the tree,
-// it is guaranteed that the subtree that is smaller gets to have the new node.
+// an array backed 4-ary heap. Parents always rank higher than their children,
+// if they exist; children are not sorted among themselves. Ranking algorithm
+// is implemented in Rankable. Each rankable remembers its position in the
+// array, so removing or re-ranking it does not need a search.
+// push / pop / remove / update are O(log n), peek is O(1). The array only
+// grows, so a heap that has reached its working size no longer allocates.
 class LocHeap {
 protected:
-    LocHeapNode* mTree;
+    static const size_t kArity = 4;
+    std::vector<LocRankable*> mNodes;
+
+    void siftUp(size_t index);
+    void siftDown(size_t index);
+    void place(LocRankable& node, size_t index);
+    // takes the node at index out of the array, returns it
+    LocRankable* removeAt(size_t index);
 public:
-    inline LocHeap() : mTree(NULL) {}
-    ~LocHeap();
+    inline LocHeap() {}
+    // nodes still in the heap are owned by the client and left untouched
+    inline ~LocHeap() {}
 
-    // push keeps the tree sorted by rank, it also tries to balance the
-    // tree by adding the new node to the smaller of the subtrees.
+    // push keeps the heap sorted by rank.
     // node is reference to an obj that is managed by client, that client
     //      creates and destroyes. The destroy should happen after the
     //      node is popped out from the heap.
     void push(LocRankable& node);
 
-    // Peeks the node data on tree top, which has currently the highest ranking
-    // There is no change the tree structure with this operation
-    // Returns NULL if the tree is empty, otherwise pointer to the node data of
-    //         the tree top.
+    // Peeks the node data on heap top, which has currently the highest ranking
+    // There is no change the heap structure with this operation
+    // Returns NULL if the heap is empty, otherwise pointer to the node data of
+    //         the heap top.
     LocRankable* peek();
 
-    // pop keeps the tree sorted by rank, but it does not try to balance
-    // the tree.
+    // pop keeps the heap sorted by rank.
     // Return - pointer to the node popped out, or NULL if heap is already empty
     LocRankable* pop();
 
-    // navigating through the tree and find the node that ranks the same
-    // as the input data, then remove it from the tree. Rank is implemented
-    // by rankable obj.
-    // returns the pointer to the node removed; or NULL (if failed).
+    // removes the input node from the heap, found by its position.
+    // returns the pointer to the node removed; or NULL (if failed, i.e. it is
+    //         not in this heap).
     LocRankable* remove(LocRankable& rankable);
 
+    // moves the input node to its place after its rank has changed.
+    // returns false if it is not in this heap.
+    bool update(LocRankable& rankable);
+
+    inline bool isEmpty() const { return mNodes.empty(); }
+    inline size_t getSize() const { return mNodes.size(); }
+
 #ifdef __LOC_UNIT_TEST__
     bool checkTree();
     uint32_t getTreeSize();
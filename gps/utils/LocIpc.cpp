@@ -29,6 +29,8 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <errno.h>
 #include <netinet/in.h>
 #include <netdb.h>
@@ -36,6 +38,7 @@
 #include <log_util.h>
 #include <LocIpc.h>
 #include <algorithm>
+#include <unordered_map>
 
 using namespace std;
 
@@ -60,6 +63,29 @@ namespace loc_util {
 
 const char Sock::MSG_ABORT[] = "LocIpc::Sock::ABORT";
 const char Sock::LOC_IPC_HEAD[] = "$MSGLEN$";
+const char Sock::LOC_IPC_FRAME[] = "$MSGFRM";
+
+// heads every part of a framed long message
+struct LocIpcFrameHead {
+    char mMagic[8];         // LOC_IPC_FRAME
+    uint32_t mSeq;          // of the message, per sending Sock
+    uint32_t mMsgLen;       // of the whole message
+    uint32_t mOffset;       // of this part in the message
+};
+
+bool Sock::isFrame(const char* data, size_t len) {
+    return len >= sizeof(LocIpcFrameHead) &&
+            memcmp(data, LOC_IPC_FRAME, sizeof(LOC_IPC_FRAME)) == 0;
+}
+
+static inline void dropFrame(LocIpcRxArena& arena) {
+    if (arena.mInFrame) {
+        LOC_LOGw("dropped framed msg %u, only got %u of %u bytes",
+                 arena.mFrameSeq, arena.mFrameRecvd, arena.mFrameLen);
+        arena.mInFrame = false;
+    }
+}
+
 ssize_t Sock::send(const void *buf, uint32_t len, int flags, const struct sockaddr *destAddr,
                           socklen_t addrlen) const {
     ssize_t rtv = -1;
@@ -72,15 +98,37 @@ ssize_t Sock::recv(const LocIpcRecver& recver, const shared_ptr<ILocIpcListener>
     if (-1 == sid) {
         sid = mSid;
     } // else it sid would be connection based socket id for recv
-    SOCK_OP_AND_LOG(dataCb.get(), mMaxTxSize, isValid(), rtv,
-                    recvfrom(recver, dataCb, sid, flags, srcAddr, addrlen));
+    if (SOCK_DGRAM == getSockType(sid)) {
+        // the rest of a framed message goes straight in place
+        if (recver.mRxArena.mInFrame) {
+            SOCK_OP_AND_LOG(dataCb.get(), mMaxTxSize, isValid(), rtv,
+                            recvFrame(recver, dataCb, sid, flags, srcAddr, addrlen));
+        } else {
+            SOCK_OP_AND_LOG(dataCb.get(), mMaxTxSize, isValid(), rtv,
+                            recvmmsg(recver, dataCb, sid, flags, srcAddr, addrlen));
+        }
+    } else {
+        SOCK_OP_AND_LOG(dataCb.get(), mMaxTxSize, isValid(), rtv,
+                        recvfrom(recver, dataCb, sid, flags, srcAddr, addrlen));
+    }
     return rtv;
 }
+int Sock::getSockType(int sid) const {
+    if (-1 == mSockType) {
+        socklen_t len = sizeof(mSockType);
+        if (getsockopt(sid, SOL_SOCKET, SO_TYPE, &mSockType, &len) < 0) {
+            mSockType = 0;
+        }
+    }
+    return mSockType;
+}
 ssize_t Sock::sendto(const void *buf, size_t len, int flags, const struct sockaddr *destAddr,
                      socklen_t addrlen) const {
     ssize_t rtv = -1;
     if (len <= mMaxTxSize) {
         rtv = ::sendto(mSid, buf, len, flags, destAddr, addrlen);
+    } else if (mFramed && SOCK_DGRAM == getSockType(mSid)) {
+        rtv = sendFramed(buf, len, flags, destAddr, addrlen);
     } else {
         std::string head(LOC_IPC_HEAD + to_string(len));
         rtv = ::sendto(mSid, head.c_str(), head.length(), flags, destAddr, addrlen);
@@ -94,37 +142,338 @@ ssize_t Sock::sendto(const void *buf, size_t len, int flags, const struct sockad
     }
     return rtv;
 }
+// Sends a long message in datagrams of up to mMaxTxSize bytes, each a
+// LocIpcFrameHead followed by the next part of buf, gathered by sendmsg()
+// straight from buf.
+ssize_t Sock::sendFramed(const void *buf, size_t len, int flags, const struct sockaddr *destAddr,
+                         socklen_t addrlen) const {
+    LocIpcFrameHead head;
+    memcpy(head.mMagic, LOC_IPC_FRAME, sizeof(head.mMagic));
+    head.mSeq = mTxSeq++;
+    head.mMsgLen = len;
+    struct iovec iov[2] = {{&head, sizeof(head)}, {nullptr, 0}};
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = (void*)destAddr;
+    msg.msg_namelen = addrlen;
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    for (size_t offset = 0; offset < len; offset += iov[1].iov_len) {
+        head.mOffset = offset;
+        iov[1].iov_base = (char*)buf + offset;
+        iov[1].iov_len = min(len - offset, (size_t)mMaxTxSize - sizeof(head));
+        if (::sendmsg(mSid, &msg, flags) <= 0) {
+            return -1;
+        }
+    }
+    return len;
+}
+
+// Takes in one part of a framed message, from the receive buffers or, if
+// received by recvFrame(), already in place in arena.mMsg. A part that does
+// not follow the one before drops the message being reassembled; the parts
+// of a message whose first part is lost are dropped as they come.
+void Sock::onFrame(const LocIpcRecver& recver, const shared_ptr<ILocIpcListener>& dataCb,
+                   const LocIpcFrameHead& head, const char* payload, uint32_t len) const {
+    LocIpcRxArena& arena = recver.mRxArena;
+    string& msg = arena.mMsg;
+    if (0 == head.mOffset) {
+        dropFrame(arena);
+        bool inPlace = (payload >= msg.data() && payload < msg.data() + msg.size());
+        if (inPlace) {
+            memmove(&msg[0], payload, len);
+        }
+        // room to receive a whole datagram past the last part, see recvFrame()
+        if (msg.size() < (size_t)head.mMsgLen + mMaxTxSize) {
+            msg.resize((size_t)head.mMsgLen + mMaxTxSize);
+        }
+        if (inPlace) {
+            payload = msg.data();
+        }
+        arena.mInFrame = true;
+        arena.mFrameSeq = head.mSeq;
+        arena.mFrameLen = head.mMsgLen;
+        arena.mFrameRecvd = 0;
+    } else if (!arena.mInFrame || head.mSeq != arena.mFrameSeq ||
+               head.mMsgLen != arena.mFrameLen || head.mOffset != arena.mFrameRecvd) {
+        dropFrame(arena);
+        return;
+    }
+    if (len > arena.mFrameLen - arena.mFrameRecvd) {
+        dropFrame(arena);
+        return;
+    }
+    if (payload != &msg[arena.mFrameRecvd]) {
+        memcpy(&msg[arena.mFrameRecvd], payload, len);
+    }
+    arena.mFrameRecvd += len;
+    if (arena.mFrameRecvd == arena.mFrameLen) {
+        arena.mInFrame = false;
+        deliver(recver, dataCb, &msg[0], arena.mFrameLen);
+    }
+}
+
+// Receives the next datagram while a framed message is being reassembled:
+// the head into a LocIpcFrameHead, the rest straight into its place in
+// arena.mMsg. Anything but a part of a framed message is copied to the
+// batch buffer and handled as usual.
+ssize_t Sock::recvFrame(const LocIpcRecver& recver, const shared_ptr<ILocIpcListener>& dataCb,
+                        int sid, int flags, struct sockaddr *srcAddr, socklen_t *addrlen) const {
+    LocIpcRxArena& arena = recver.mRxArena;
+    LocIpcFrameHead head;
+    struct iovec iov[2] = {{&head, sizeof(head)},
+                           {&arena.mMsg[arena.mFrameRecvd], mMaxTxSize - sizeof(head)}};
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    if (nullptr != srcAddr && nullptr != addrlen) {
+        msg.msg_name = srcAddr;
+        msg.msg_namelen = *addrlen;
+    }
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    ssize_t nBytes = ::recvmsg(sid, &msg, flags);
+    if (nBytes <= 0) {
+        return nBytes;
+    }
+    if (nullptr != srcAddr && nullptr != addrlen) {
+        *addrlen = msg.msg_namelen;
+    }
+    if (isFrame((const char*)&head, nBytes)) {
+        onFrame(recver, dataCb, head, (const char*)iov[1].iov_base, nBytes - sizeof(head));
+        return nBytes;
+    }
+
+    if (arena.mBatch.size() < (size_t)mMaxTxSize + 1) {
+        arena.mBatch.resize((size_t)mMaxTxSize + 1);
+    }
+    memcpy(&arena.mBatch[0], &head, min((size_t)nBytes, sizeof(head)));
+    if ((size_t)nBytes > sizeof(head)) {
+        memcpy(&arena.mBatch[sizeof(head)], iov[1].iov_base, nBytes - sizeof(head));
+    }
+    arena.mBatch[nBytes] = 0;
+    return onDatagram(recver, dataCb, sid, flags, srcAddr, addrlen, &arena.mBatch[0], nBytes);
+}
+
+// Handles one datagram of a message socket, NUL terminated at data[nBytes];
+// returns 0 on abort
+ssize_t Sock::onDatagram(const LocIpcRecver& recver, const shared_ptr<ILocIpcListener>& dataCb,
+                         int sid, int flags, struct sockaddr *srcAddr, socklen_t *addrlen,
+                         char* data, ssize_t nBytes) const {
+    LocIpcRxArena& arena = recver.mRxArena;
+    if (isFrame(data, nBytes)) {
+        LocIpcFrameHead head;
+        memcpy(&head, data, sizeof(head));
+        onFrame(recver, dataCb, head, data + sizeof(head), nBytes - sizeof(head));
+        return nBytes;
+    }
+    dropFrame(arena);
+    if (strncmp(data, MSG_ABORT, sizeof(MSG_ABORT)) == 0) {
+        LOC_LOGi("recvd abort msg.data %s", data);
+        nBytes = 0;
+    } else if (strncmp(data, LOC_IPC_HEAD, sizeof(LOC_IPC_HEAD) - 1)) {
+        // short message
+        deliver(recver, dataCb, data, nBytes);
+    } else {
+        // long message
+        size_t msgLen = 0;
+        sscanf(data + sizeof(LOC_IPC_HEAD) - 1, "%zu", &msgLen);
+        if (arena.mMsg.size() < msgLen + 1) {
+            arena.mMsg.resize(msgLen + 1);
+        }
+        nBytes = recvLongMsg(recver, sid, flags, srcAddr, addrlen, msgLen, 0);
+        if (nBytes > 0) {
+            deliver(recver, dataCb, &arena.mMsg[0], nBytes);
+        }
+    }
+    return nBytes;
+}
+
+// Hands a received message to the listener, as a NUL terminated view into
+// the arena, which has room for the NUL past every message; or, if the
+// listener takes ownership, in a string of its own. A long message,
+// reassembled in arena.mMsg, is handed over in that very buffer.
+void Sock::deliver(const LocIpcRecver& recver, const shared_ptr<ILocIpcListener>& dataCb,
+                   char* data, uint32_t len) const {
+    if (!dataCb->wantsOwnership()) {
+        data[len] = 0;
+        dataCb->onReceive(data, len, &recver);
+    } else if (data == recver.mRxArena.mMsg.data()) {
+        string& msg = recver.mRxArena.mMsg;
+        msg.resize(len);
+        dataCb->onReceiveOwned(std::move(msg), &recver);
+        msg.clear();
+    } else {
+        dataCb->onReceiveOwned(string(data, len), &recver);
+    }
+}
+
+// Receives the fragments of a long message of msgLen bytes into arena.mMsg,
+// past the msgLenReceived bytes already there.
+ssize_t Sock::recvLongMsg(const LocIpcRecver& recver, int sid, int flags,
+                          struct sockaddr *srcAddr, socklen_t *addrlen,
+                          size_t msgLen, size_t msgLenReceived) const {
+    string& msg = recver.mRxArena.mMsg;
+    ssize_t nBytes = 1;
+    for (; (msgLenReceived < msgLen) && (nBytes > 0); msgLenReceived += nBytes) {
+        nBytes = ::recvfrom(sid, &(msg[msgLenReceived]), msgLen - msgLenReceived,
+                            flags, srcAddr, addrlen);
+    }
+    return (nBytes > 0) ? msgLen : nBytes;
+}
+
 ssize_t Sock::recvfrom(const LocIpcRecver& recver, const shared_ptr<ILocIpcListener>& dataCb,
                        int sid, int flags, struct sockaddr *srcAddr, socklen_t *addrlen) const  {
-    std::string msg(mMaxTxSize, 0);
-    ssize_t nBytes = ::recvfrom(sid, (void*)msg.data(), msg.size(), flags, srcAddr, addrlen);
+    string& msg = recver.mRxArena.mMsg;
+    if (msg.size() < (size_t)mMaxTxSize + 1) {
+        msg.resize((size_t)mMaxTxSize + 1);
+    }
+    ssize_t nBytes = ::recvfrom(sid, &(msg[0]), mMaxTxSize, flags, srcAddr, addrlen);
     if (nBytes > 0) {
+        msg[nBytes] = 0;
         if (strncmp(msg.data(), MSG_ABORT, sizeof(MSG_ABORT)) == 0) {
             LOC_LOGi("recvd abort msg.data %s", msg.data());
             nBytes = 0;
         } else if (strncmp(msg.data(), LOC_IPC_HEAD, sizeof(LOC_IPC_HEAD) - 1)) {
             // short message
-            msg.resize(nBytes);
-            dataCb->onReceive(msg.data(), nBytes, &recver);
+            deliver(recver, dataCb, &msg[0], nBytes);
         } else {
             // long message
             size_t msgLen = 0;
             sscanf(msg.data() + sizeof(LOC_IPC_HEAD) - 1, "%zu", &msgLen);
-            msg.resize(msgLen);
-            for (size_t msgLenReceived = 0; (msgLenReceived < msgLen) && (nBytes > 0);
-                 msgLenReceived += nBytes) {
-                nBytes = ::recvfrom(sid, &(msg[msgLenReceived]), msg.size() - msgLenReceived,
-                                    flags, srcAddr, addrlen);
+            if (msg.size() < msgLen + 1) {
+                msg.resize(msgLen + 1);
             }
+            nBytes = recvLongMsg(recver, sid, flags, srcAddr, addrlen, msgLen, 0);
             if (nBytes > 0) {
-                nBytes = msgLen;
-                dataCb->onReceive(msg.data(), nBytes, &recver);
+                deliver(recver, dataCb, &msg[0], nBytes);
+            }
+        }
+    }
+
+    return nBytes;
+}
+
+// Takes up to kBatchSize datagrams in one recvmmsg() call, waiting only for
+// the first, and dispatches them in order. The fragments of a long message
+// are taken from the batch first, then received one by one.
+ssize_t Sock::recvmmsg(const LocIpcRecver& recver, const shared_ptr<ILocIpcListener>& dataCb,
+                       int sid, int flags, struct sockaddr *srcAddr, socklen_t *addrlen) const {
+    LocIpcRxArena& arena = recver.mRxArena;
+    // each datagram gets a byte past it for its NUL
+    const size_t slotSize = (size_t)mMaxTxSize + 1;
+    if (arena.mBatch.size() < kBatchSize * slotSize) {
+        arena.mBatch.resize(kBatchSize * slotSize);
+        arena.mAddrs.resize(kBatchSize);
+    }
+    struct mmsghdr msgs[kBatchSize];
+    struct iovec iovs[kBatchSize];
+    memset(msgs, 0, sizeof(msgs));
+    for (uint32_t i = 0; i < kBatchSize; i++) {
+        iovs[i].iov_base = &arena.mBatch[i * slotSize];
+        iovs[i].iov_len = mMaxTxSize;
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        if (nullptr != srcAddr && nullptr != addrlen) {
+            msgs[i].msg_hdr.msg_name = &arena.mAddrs[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(arena.mAddrs[i]);
+        }
+    }
+
+    int count = ::recvmmsg(sid, msgs, kBatchSize, flags | MSG_WAITFORONE, nullptr);
+    ssize_t nBytes = (count > 0) ? 0 : count;
+    int i = 0;
+    for (; i < count; i++) {
+        char* data = (char*)iovs[i].iov_base;
+        nBytes = msgs[i].msg_len;
+        if (nBytes <= 0) {
+            break;
+        }
+        data[nBytes] = 0;
+        if (isFrame(data, nBytes) ||
+            strncmp(data, LOC_IPC_HEAD, sizeof(LOC_IPC_HEAD) - 1)) {
+            // short message, abort, or part of a framed message
+            nBytes = onDatagram(recver, dataCb, sid, flags, srcAddr, addrlen, data, nBytes);
+            if (0 == nBytes) {
+                break;
             }
+        } else {
+            // long message, reassembled in place in arena.mMsg
+            dropFrame(arena);
+            size_t msgLen = 0;
+            sscanf(data + sizeof(LOC_IPC_HEAD) - 1, "%zu", &msgLen);
+            string& msg = arena.mMsg;
+            if (msg.size() < msgLen + 1) {
+                msg.resize(msgLen + 1);
+            }
+            size_t msgLenReceived = 0;
+            while (msgLenReceived < msgLen && i + 1 < count) {
+                i++;
+                size_t len = min((size_t)msgs[i].msg_len, msgLen - msgLenReceived);
+                memcpy(&(msg[msgLenReceived]), iovs[i].iov_base, len);
+                msgLenReceived += len;
+            }
+            nBytes = recvLongMsg(recver, sid, flags, srcAddr, addrlen, msgLen, msgLenReceived);
+            if (nBytes <= 0) {
+                break;
+            }
+            deliver(recver, dataCb, &msg[0], nBytes);
         }
     }
 
+    // the source of the last datagram, as recvfrom() would have reported
+    if (i > 0 && nullptr != srcAddr && nullptr != addrlen) {
+        socklen_t len = min(*addrlen, msgs[i - 1].msg_hdr.msg_namelen);
+        memcpy(srcAddr, &arena.mAddrs[i - 1], len);
+        *addrlen = msgs[i - 1].msg_hdr.msg_namelen;
+    }
+
     return nBytes;
 }
+
+// Messages that fit in one datagram go out kBatchSize at a time with
+// sendmmsg(); longer ones are sent on their own, see sendto().
+uint32_t Sock::sendBatch(const LocIpcSpan spans[], uint32_t count, int flags,
+                         const struct sockaddr *destAddr, socklen_t addrlen) const {
+    struct mmsghdr msgs[kBatchSize];
+    struct iovec iovs[kBatchSize];
+    uint32_t sent = 0;
+    while (sent < count && isValid()) {
+        if (nullptr == spans[sent].data || 0 == spans[sent].length) {
+            LOC_LOGe("Invalid inputs: buf - %p, length - %u",
+                     spans[sent].data, spans[sent].length);
+            break;
+        }
+        if (spans[sent].length > mMaxTxSize) {
+            if (sendto(spans[sent].data, spans[sent].length, flags, destAddr, addrlen) <= 0) {
+                LOC_LOGw("failed reason: %s", strerror(errno));
+                break;
+            }
+            sent++;
+            continue;
+        }
+
+        uint32_t n = 0;
+        memset(msgs, 0, sizeof(msgs));
+        for (; n < kBatchSize && sent + n < count &&
+               nullptr != spans[sent + n].data && 0 != spans[sent + n].length &&
+               spans[sent + n].length <= mMaxTxSize; n++) {
+            iovs[n].iov_base = (void*)spans[sent + n].data;
+            iovs[n].iov_len = spans[sent + n].length;
+            msgs[n].msg_hdr.msg_iov = &iovs[n];
+            msgs[n].msg_hdr.msg_iovlen = 1;
+            msgs[n].msg_hdr.msg_name = (void*)destAddr;
+            msgs[n].msg_hdr.msg_namelen = addrlen;
+        }
+        int rtv = ::sendmmsg(mSid, msgs, n, flags);
+        if (rtv <= 0) {
+            LOC_LOGw("failed reason: %s", strerror(errno));
+            break;
+        }
+        sent += rtv;
+    }
+    return sent;
+}
+
 ssize_t Sock::sendAbort(int flags, const struct sockaddr *destAddr, socklen_t addrlen) {
     return send(MSG_ABORT, sizeof(MSG_ABORT), flags, destAddr, addrlen);
 }
@@ -137,8 +486,11 @@ protected:
     inline virtual ssize_t send(const uint8_t data[], uint32_t length, int32_t /* msgId */) const {
         return mSock->send(data, length, 0, (struct sockaddr*)&mAddr, sizeof(mAddr));
     }
+    inline virtual uint32_t sendBatch(const LocIpcSpan spans[], uint32_t count) const override {
+        return mSock->sendBatch(spans, count, 0, (struct sockaddr*)&mAddr, sizeof(mAddr));
+    }
 public:
-    inline LocIpcLocalSender(const char* name) : LocIpcSender(),
+    inline LocIpcLocalSender(const char* name, bool framed = false) : LocIpcSender(),
             mSock(nullptr),
             mAddr({.sun_family = AF_UNIX, {}}) {
 
@@ -152,7 +504,7 @@ public:
                 setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
             }
         }
-        mSock.reset(new Sock(fd));
+        mSock.reset(new Sock(fd, 8192, framed));
         if (mSock != nullptr && mSock->isValid()) {
             snprintf(mAddr.sun_path, sizeof(mAddr.sun_path), "%s", name);
         }
@@ -187,6 +539,7 @@ public:
             mSock->sendAbort(0, (struct sockaddr*)&mAddr, sizeof(mAddr));
         }
     }
+    inline virtual int getPollFd() const override { return mSock->mSid; }
 };
 
 class LocIpcInetSender : public LocIpcSender {
@@ -199,14 +552,23 @@ protected:
     virtual ssize_t send(const uint8_t data[], uint32_t length, int32_t /* msgId */) const {
         return mSock->send(data, length, 0, (struct sockaddr*)&mAddr, sizeof(mAddr));
     }
+    virtual uint32_t sendBatch(const LocIpcSpan spans[], uint32_t count) const override {
+        // a stream would merge the messages, TCP keeps sending them one by one
+        if (SOCK_DGRAM != mSockType) {
+            return LocIpcSender::sendBatch(spans, count);
+        }
+        return mSock->sendBatch(spans, count, 0, (struct sockaddr*)&mAddr, sizeof(mAddr));
+    }
 public:
     inline LocIpcInetSender(const LocIpcInetSender& sender) :
             mSockType(sender.mSockType), mSock(sender.mSock),
             mName(sender.mName), mAddr(sender.mAddr) {
     }
-    inline LocIpcInetSender(const char* name, int32_t port, int sockType) : LocIpcSender(),
+    inline LocIpcInetSender(const char* name, int32_t port, int sockType,
+                            bool framed = false) : LocIpcSender(),
             mSockType(sockType),
-            mSock(make_shared<Sock>((nullptr == name) ? -1 : (::socket(AF_INET, mSockType, 0)))),
+            mSock(make_shared<Sock>((nullptr == name) ? -1 : (::socket(AF_INET, mSockType, 0)),
+                                    8192, framed)),
             mName((nullptr == name) ? "" : name),
             mAddr({.sin_family = AF_INET, .sin_port = htons(port),
                     .sin_addr = {htonl(INADDR_ANY)}}) {
@@ -272,21 +634,32 @@ public:
 class LocIpcInetTcpRecver : public LocIpcInetRecver {
     mutable int32_t mConnFd;
 protected:
+    // the first call only accepts the connection, so that a LocIpcReactor
+    // can wait for the data on it
     inline virtual ssize_t recv() const override {
         socklen_t size = sizeof(mAddr);
         if (-1 == mConnFd && mSock->isValid()) {
-            if (::listen(mSock->mSid, 3) < 0 ||
-                (mConnFd = accept(mSock->mSid, (struct sockaddr*)&mAddr, &size)) < 0) {
+            if ((mConnFd = accept(mSock->mSid, (struct sockaddr*)&mAddr, &size)) < 0) {
                 mSock->close();
                 mConnFd = -1;
+                return -1;
             }
+            return 1;
         }
         return mSock->recv(*this, mDataCb, 0, (struct sockaddr*)&mAddr, &size, mConnFd);
     }
 public:
     inline LocIpcInetTcpRecver(const shared_ptr<ILocIpcListener>& listener, const char* name,
                                int32_t port) :
-            LocIpcInetRecver(listener, name, port, SOCK_STREAM), mConnFd(-1) {}
+            LocIpcInetRecver(listener, name, port, SOCK_STREAM), mConnFd(-1) {
+        if (mSock->isValid() && ::listen(mSock->mSid, 3) < 0) {
+            LOC_LOGe("listen socket error. sock fd: %d, reason: %s", mSock->mSid, strerror(errno));
+            mSock->close();
+        }
+    }
+    inline virtual int getPollFd() const override {
+        return (-1 != mConnFd) ? mConnFd : mSock->mSid;
+    }
     inline virtual ~LocIpcInetTcpRecver() { if (-1 != mConnFd) ::close(mConnFd);}
 };
 
@@ -302,6 +675,7 @@ public:
             LocIpcInetRecver(listener, name, port, SOCK_DGRAM) {}
 
     inline virtual ~LocIpcInetUdpRecver() {}
+    inline virtual int getPollFd() const override { return mSock->mSid; }
 };
 
 class LocIpcRunnable : public LocRunnable {
@@ -335,7 +709,8 @@ bool LocIpc::startNonBlockingListening(unique_ptr<LocIpcRecver>& ipcRecver) {
     if (ipcRecver != nullptr && ipcRecver->isRecvable()) {
         std::string threadName("LocIpc-");
         threadName.append(ipcRecver->getName());
-        return mThread.start(threadName.c_str(), make_shared<LocIpcRunnable>(*this, ipcRecver));
+        return mThread.start(threadName.c_str(), make_shared<LocIpcRunnable>(*this, ipcRecver),
+                             LocThreadAttr::fromConf("IPC"));
     } else {
         LOC_LOGe("ipcRecver is null OR ipcRecver->recvable() is fasle");
         return false;
@@ -364,12 +739,208 @@ void LocIpc::stopBlockingListening(LocIpcRecver& ipcRecver) {
     }
 }
 
+// The recvers are only touched on the reactor thread: addRecver() and
+// removeRecver() queue requests which the thread picks up on its next round.
+class LocIpcReactorRunnable : public LocRunnable {
+    static const int kMaxEvents = 16;
+    struct Served {
+        unique_ptr<LocIpcRecver> mRecver;
+        int mFd;
+    };
+    const int mEpollFd;
+    const int mWakeFd;
+    mutex mMutex;
+    vector<unique_ptr<LocIpcRecver>> mToAdd;
+    vector<const LocIpcRecver*> mToRemove;
+    bool mStopped;
+    // reactor thread only
+    unordered_map<const LocIpcRecver*, Served> mServed;
+
+    inline void wake() {
+        uint64_t one = 1;
+        if (write(mWakeFd, &one, sizeof(one)) < 0) {
+            LOC_LOGw("failed reason: %s", strerror(errno));
+        }
+    }
+    void serve(unique_ptr<LocIpcRecver>& recver);
+    void unserve(const LocIpcRecver* recver);
+    void onReadable(const LocIpcRecver* recver);
+public:
+    inline LocIpcReactorRunnable() :
+            mEpollFd(epoll_create1(EPOLL_CLOEXEC)),
+            mWakeFd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)), mStopped(false) {
+        struct epoll_event ev = {.events = EPOLLIN, .data = {.ptr = nullptr}};
+        if (isValid() && epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mWakeFd, &ev) < 0) {
+            LOC_LOGe("failed reason: %s", strerror(errno));
+        }
+    }
+    inline virtual ~LocIpcReactorRunnable() {
+        if (mEpollFd >= 0) ::close(mEpollFd);
+        if (mWakeFd >= 0) ::close(mWakeFd);
+    }
+    inline bool isValid() const { return mEpollFd >= 0 && mWakeFd >= 0; }
+    inline bool add(unique_ptr<LocIpcRecver>& recver) {
+        lock_guard<mutex> lock(mMutex);
+        if (mStopped) {
+            return false;
+        }
+        mToAdd.push_back(move(recver));
+        wake();
+        return true;
+    }
+    inline void remove(const LocIpcRecver* recver) {
+        lock_guard<mutex> lock(mMutex);
+        mToRemove.push_back(recver);
+        wake();
+    }
+    virtual bool run() override;
+    virtual void postrun() override;
+    inline virtual void interrupt() override {
+        lock_guard<mutex> lock(mMutex);
+        mStopped = true;
+        wake();
+    }
+};
+
+void LocIpcReactorRunnable::serve(unique_ptr<LocIpcRecver>& recver) {
+    int fd = recver->getPollFd();
+    struct epoll_event ev = {.events = EPOLLIN, .data = {.ptr = recver.get()}};
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        LOC_LOGe("%s can not be served: %s", recver->getName(), strerror(errno));
+        return;
+    }
+    const LocIpcRecver* key = recver.get();
+    mServed[key] = {move(recver), fd};
+    mServed[key].mRecver->onListenerReady();
+}
+
+void LocIpcReactorRunnable::unserve(const LocIpcRecver* recver) {
+    auto it = mServed.find(recver);
+    if (it != mServed.end()) {
+        epoll_ctl(mEpollFd, EPOLL_CTL_DEL, it->second.mFd, nullptr);
+        mServed.erase(it);
+    }
+}
+
+void LocIpcReactorRunnable::onReadable(const LocIpcRecver* recver) {
+    auto it = mServed.find(recver);
+    if (it == mServed.end()) {
+        // unserved earlier in the same round
+        return;
+    }
+    Served& served = it->second;
+    if (!served.mRecver->recvData()) {
+        LOC_LOGi("%s stopped receiving", served.mRecver->getName());
+        unserve(recver);
+        return;
+    }
+    int fd = served.mRecver->getPollFd();
+    if (fd != served.mFd) {
+        struct epoll_event ev = {.events = EPOLLIN, .data = {.ptr = (void*)recver}};
+        epoll_ctl(mEpollFd, EPOLL_CTL_DEL, served.mFd, nullptr);
+        served.mFd = fd;
+        if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            LOC_LOGe("%s can not be served: %s", served.mRecver->getName(), strerror(errno));
+            unserve(recver);
+        }
+    }
+}
+
+// one round: wait for any of the recvers, or for a request
+bool LocIpcReactorRunnable::run() {
+    struct epoll_event events[kMaxEvents];
+    int count = epoll_wait(mEpollFd, events, kMaxEvents, -1);
+    if (count < 0 && EINTR != errno) {
+        LOC_LOGe("epoll_wait failed: %s", strerror(errno));
+        return false;
+    }
+
+    bool woken = false;
+    for (int i = 0; i < count; i++) {
+        if (nullptr == events[i].data.ptr) {
+            woken = true;
+        } else {
+            onReadable((const LocIpcRecver*)events[i].data.ptr);
+        }
+    }
+
+    if (woken) {
+        uint64_t wakes;
+        while (read(mWakeFd, &wakes, sizeof(wakes)) > 0);
+        vector<unique_ptr<LocIpcRecver>> toAdd;
+        vector<const LocIpcRecver*> toRemove;
+        {
+            lock_guard<mutex> lock(mMutex);
+            if (mStopped) {
+                return false;
+            }
+            toAdd.swap(mToAdd);
+            toRemove.swap(mToRemove);
+        }
+        for (auto& recver : toAdd) {
+            serve(recver);
+        }
+        for (auto recver : toRemove) {
+            unserve(recver);
+        }
+    }
+    return true;
+}
+
+// destroys the recvers on the reactor thread, as it does with removed ones
+void LocIpcReactorRunnable::postrun() {
+    for (auto& served : mServed) {
+        epoll_ctl(mEpollFd, EPOLL_CTL_DEL, served.second.mFd, nullptr);
+    }
+    mServed.clear();
+    lock_guard<mutex> lock(mMutex);
+    mStopped = true;
+    mToAdd.clear();
+}
+
+bool LocIpcReactor::start(const char* threadName) {
+    if (mThread.isRunning()) {
+        return true;
+    }
+    mRunnable = make_shared<LocIpcReactorRunnable>();
+    if (!mRunnable->isValid() ||
+        !mThread.start(threadName, mRunnable, LocThreadAttr::fromConf("IPC"))) {
+        LOC_LOGe("failed to start %s", threadName);
+        mRunnable = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void LocIpcReactor::stop() {
+    mThread.stop();
+    mRunnable = nullptr;
+}
+
+bool LocIpcReactor::addRecver(unique_ptr<LocIpcRecver>& ipcRecver) {
+    if (ipcRecver == nullptr || !ipcRecver->isRecvable() || -1 == ipcRecver->getPollFd()) {
+        LOC_LOGe("ipcRecver is null OR can not be waited on");
+        return false;
+    }
+    return mRunnable != nullptr && mRunnable->add(ipcRecver);
+}
+
+void LocIpcReactor::removeRecver(const LocIpcRecver* ipcRecver) {
+    if (mRunnable != nullptr) {
+        mRunnable->remove(ipcRecver);
+    }
+}
+
 bool LocIpc::send(LocIpcSender& sender, const uint8_t data[], uint32_t length, int32_t msgId) {
     return sender.sendData(data, length, msgId);
 }
 
-shared_ptr<LocIpcSender> LocIpc::getLocIpcLocalSender(const char* localSockName) {
-    return make_shared<LocIpcLocalSender>(localSockName);
+bool LocIpc::sendBatch(LocIpcSender& sender, const LocIpcSpan spans[], uint32_t count) {
+    return sender.sendDataBatch(spans, count);
+}
+
+shared_ptr<LocIpcSender> LocIpc::getLocIpcLocalSender(const char* localSockName, bool framed) {
+    return make_shared<LocIpcLocalSender>(localSockName, framed);
 }
 unique_ptr<LocIpcRecver> LocIpc::getLocIpcLocalRecver(const shared_ptr<ILocIpcListener>& listener,
                                                       const char* localSockName) {
@@ -403,8 +974,9 @@ unique_ptr<LocIpcRecver> LocIpc::getLocIpcInetTcpRecver(const shared_ptr<ILocIpc
                                                             const char* serverName, int32_t port) {
     return make_unique<LocIpcInetTcpRecver>(listener, serverName, port);
 }
-shared_ptr<LocIpcSender> LocIpc::getLocIpcInetUdpSender(const char* serverName, int32_t port) {
-    return make_shared<LocIpcInetSender>(serverName, port, SOCK_DGRAM);
+shared_ptr<LocIpcSender> LocIpc::getLocIpcInetUdpSender(const char* serverName, int32_t port,
+                                                        bool framed) {
+    return make_shared<LocIpcInetSender>(serverName, port, SOCK_DGRAM, framed);
 }
 unique_ptr<LocIpcRecver> LocIpc::getLocIpcInetUdpRecver(const shared_ptr<ILocIpcListener>& listener,
                                                              const char* serverName, int32_t port) {
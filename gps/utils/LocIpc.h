@@ -32,11 +32,13 @@
 
 #include <string>
 #include <memory>
+#include <vector>
 #include <unistd.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <unordered_set>
 #include <mutex>
+#include <atomic>
 #include <LocThread.h>
 
 using namespace std;
@@ -46,6 +48,12 @@ namespace loc_util {
 class LocIpcRecver;
 class LocIpcSender;
 
+// one message of a LocIpc::sendBatch()
+struct LocIpcSpan {
+    const uint8_t* data;
+    uint32_t length;
+};
+
 class ILocIpcListener {
 protected:
     inline virtual ~ILocIpcListener() {}
@@ -53,7 +61,33 @@ public:
     // LocIpc client can overwrite this function to get notification
     // when the socket for LocIpc is ready to receive messages.
     inline virtual void onListenerReady() {}
+    // data is a view into the receive buffers of recver, NUL terminated at
+    // data[len], only valid until this call returns; copy what needs to be kept.
     virtual void onReceive(const char* data, uint32_t len, const LocIpcRecver* recver) = 0;
+    // Listeners that keep the data, e.g. to queue it to a MsgTask, can take
+    // it over instead: return true from wantsOwnership() and override
+    // onReceiveOwned(), which is then called instead of onReceive(). Long
+    // messages are handed over in the buffer they were reassembled in,
+    // without another copy.
+    inline virtual bool wantsOwnership() const { return false; }
+    inline virtual void onReceiveOwned(string&& data, const LocIpcRecver* recver) {
+        onReceive(data.data(), data.size(), recver);
+    }
+};
+
+// Receive buffers of a LocIpcRecver, grown on demand and then reused, so
+// that receiving does not allocate once they have reached their working size.
+struct LocIpcRxArena {
+    // datagrams of one recvmmsg() call and their source addresses
+    vector<char> mBatch;
+    vector<struct sockaddr_storage> mAddrs;
+    // long message reassembly; whole receive buffer for stream sockets
+    string mMsg;
+    // framed long message being reassembled in mMsg, see Sock::sendFramed()
+    bool mInFrame = false;
+    uint32_t mFrameSeq = 0;
+    uint32_t mFrameLen = 0;
+    uint32_t mFrameRecvd = 0;
 };
 
 class LocIpcQrtrWatcher {
@@ -93,10 +127,15 @@ public:
         stopNonBlockingListening();
     }
 
+    // Messages longer than a datagram are sent in parts. With framed, each
+    // part carries the message sequence number and its offset, so that the
+    // recver can tell when parts went missing and drop the message; the
+    // recver must be built from this version of LocIpc or later. Without,
+    // the parts follow a plain length header, as older recvers expect.
     static shared_ptr<LocIpcSender>
-            getLocIpcLocalSender(const char* localSockName);
+            getLocIpcLocalSender(const char* localSockName, bool framed = false);
     static shared_ptr<LocIpcSender>
-            getLocIpcInetUdpSender(const char* serverName, int32_t port);
+            getLocIpcInetUdpSender(const char* serverName, int32_t port, bool framed = false);
     static shared_ptr<LocIpcSender>
             getLocIpcInetTcpSender(const char* serverName, int32_t port);
     static shared_ptr<LocIpcSender>
@@ -105,6 +144,16 @@ public:
     static unique_ptr<LocIpcRecver>
             getLocIpcLocalRecver(const shared_ptr<ILocIpcListener>& listener,
                                  const char* localSockName);
+    // Shared memory transport for high rate local consumers: messages go
+    // through a memfd backed ring set up by the sender with the recver
+    // listening on shmSockName, without copies through the kernel. Each
+    // sender gets a ring of its own, of at least ringSize bytes; messages
+    // over half the ring size are rejected.
+    static shared_ptr<LocIpcSender>
+            getLocIpcShmSender(const char* shmSockName, uint32_t ringSize = 512 * 1024);
+    static unique_ptr<LocIpcRecver>
+            getLocIpcShmRecver(const shared_ptr<ILocIpcListener>& listener,
+                               const char* shmSockName);
     static unique_ptr<LocIpcRecver>
             getLocIpcInetUdpRecver(const shared_ptr<ILocIpcListener>& listener,
                                  const char* serverName, int32_t port);
@@ -148,8 +197,45 @@ public:
     static bool send(LocIpcSender& sender, const uint8_t data[],
                      uint32_t length, int32_t msgId = -1);
 
+    // Send out count messages in one go, in order; local and UDP senders
+    // hand them to the kernel with as few sendmmsg() calls as possible.
+    // The function will return true if all messages are sent, and false
+    // otherwise.
+    static bool sendBatch(LocIpcSender& sender, const LocIpcSpan spans[], uint32_t count);
+
+private:
+    LocThread mThread;
+};
+
+// Serves any number of LocIpcRecvers from one thread, waiting on all of them
+// with epoll instead of keeping a thread blocked in each. Recvers are handed
+// over with addRecver() and owned, and eventually destroyed, by the reactor
+// thread. A recver leaves the reactor when removeRecver() is called, when it
+// is aborted through the usual abort() / stopBlockingListening() path, or
+// when receiving fails, just as its own listening thread would have exited.
+// Only recvers with a pollable fd, see LocIpcRecver::getPollFd(), can be
+// served; others still need LocIpc::startNonBlockingListening().
+class LocIpcReactorRunnable;
+class LocIpcReactor {
+public:
+    inline LocIpcReactor() = default;
+    inline virtual ~LocIpcReactor() { stop(); }
+
+    bool start(const char* threadName = "LocIpcReactor");
+    // destroys all the recvers still served
+    void stop();
+
+    // onListenerReady() is called on the reactor thread once the recver is
+    // being waited on. Returns false, leaving ipcRecver with the caller, if
+    // the reactor is not running or ipcRecver can not be served.
+    bool addRecver(unique_ptr<LocIpcRecver>& ipcRecver);
+    // ipcRecver is destroyed on the reactor thread, possibly after this
+    // returns; it must not be used by the caller any more.
+    void removeRecver(const LocIpcRecver* ipcRecver);
+
 private:
     LocThread mThread;
+    shared_ptr<LocIpcReactorRunnable> mRunnable;
 };
 
 /* this is only when client needs to implement Sender / Recver that are not already provided by
@@ -160,12 +246,23 @@ protected:
     LocIpcSender() = default;
     virtual bool isOperable() const = 0;
     virtual ssize_t send(const uint8_t data[], uint32_t length, int32_t msgId) const = 0;
+    // returns the number of spans sent, counted from the first one
+    inline virtual uint32_t sendBatch(const LocIpcSpan spans[], uint32_t count) const {
+        uint32_t sent = 0;
+        while (sent < count && send(spans[sent].data, spans[sent].length, -1) > 0) {
+            sent++;
+        }
+        return sent;
+    }
 public:
     virtual ~LocIpcSender() = default;
     inline bool isSendable() const { return isOperable(); }
     inline bool sendData(const uint8_t data[], uint32_t length, int32_t msgId) const {
         return isSendable() && (send(data, length, msgId) > 0);
     }
+    inline bool sendDataBatch(const LocIpcSpan spans[], uint32_t count) const {
+        return isSendable() && (sendBatch(spans, count) == count);
+    }
     virtual unique_ptr<LocIpcRecver> getRecver(const shared_ptr<ILocIpcListener>& listener __unused) {
         return nullptr;
     }
@@ -174,6 +271,8 @@ public:
 
 class LocIpcRecver {
     LocIpcSender& mIpcSender;
+    friend class Sock;
+    mutable LocIpcRxArena mRxArena;
 protected:
     const shared_ptr<ILocIpcListener> mDataCb;
     inline LocIpcRecver(const shared_ptr<ILocIpcListener>& listener, LocIpcSender& sender) :
@@ -191,25 +290,57 @@ public:
     }
     virtual void abort() const = 0;
     virtual const char* getName() const = 0;
+    // An fd that polls readable when recv() has something to receive, so
+    // that the recver can be served by a LocIpcReactor; -1 if none. It may
+    // change after each recv(), e.g. once a connection is accepted.
+    inline virtual int getPollFd() const { return -1; }
 };
 
 class Sock {
     static const char MSG_ABORT[];
     static const char LOC_IPC_HEAD[];
+    static const char LOC_IPC_FRAME[];
+    // max datagrams per recvmmsg() / sendmmsg() call
+    static const uint32_t kBatchSize = 8;
     const uint32_t mMaxTxSize;
+    const bool mFramed;
+    mutable int mSockType;
+    mutable atomic<uint32_t> mTxSeq;
+    static bool isFrame(const char* data, size_t len);
+    int getSockType(int sid) const;
     ssize_t sendto(const void *buf, size_t len, int flags, const struct sockaddr *destAddr,
                    socklen_t addrlen) const;
+    ssize_t sendFramed(const void *buf, size_t len, int flags, const struct sockaddr *destAddr,
+                       socklen_t addrlen) const;
+    ssize_t recvFrame(const LocIpcRecver& recver, const shared_ptr<ILocIpcListener>& dataCb,
+                      int sid, int flags, struct sockaddr *srcAddr, socklen_t *addrlen) const;
+    void onFrame(const LocIpcRecver& recver, const shared_ptr<ILocIpcListener>& dataCb,
+                 const struct LocIpcFrameHead& head, const char* payload, uint32_t len) const;
+    ssize_t onDatagram(const LocIpcRecver& recver, const shared_ptr<ILocIpcListener>& dataCb,
+                       int sid, int flags, struct sockaddr *srcAddr, socklen_t *addrlen,
+                       char* data, ssize_t len) const;
     ssize_t recvfrom(const LocIpcRecver& recver, const shared_ptr<ILocIpcListener>& dataCb,
                      int sid, int flags, struct sockaddr *srcAddr, socklen_t *addrlen) const;
+    ssize_t recvmmsg(const LocIpcRecver& recver, const shared_ptr<ILocIpcListener>& dataCb,
+                     int sid, int flags, struct sockaddr *srcAddr, socklen_t *addrlen) const;
+    ssize_t recvLongMsg(const LocIpcRecver& recver, int sid, int flags,
+                        struct sockaddr *srcAddr, socklen_t *addrlen,
+                        size_t msgLen, size_t msgLenReceived) const;
+    void deliver(const LocIpcRecver& recver, const shared_ptr<ILocIpcListener>& dataCb,
+                 char* data, uint32_t len) const;
 public:
     int mSid;
-    inline Sock(int sid, const uint32_t maxTxSize = 8192) : mMaxTxSize(maxTxSize), mSid(sid) {}
+    inline Sock(int sid, const uint32_t maxTxSize = 8192, bool framed = false) :
+            mMaxTxSize(maxTxSize), mFramed(framed), mSockType(-1), mTxSeq(0), mSid(sid) {}
     inline ~Sock() { close(); }
     inline bool isValid() const { return -1 != mSid; }
     ssize_t send(const void *buf, uint32_t len, int flags, const struct sockaddr *destAddr,
                  socklen_t addrlen) const;
     ssize_t recv(const LocIpcRecver& recver, const shared_ptr<ILocIpcListener>& dataCb, int flags,
                  struct sockaddr *srcAddr, socklen_t *addrlen, int sid = -1) const;
+    // returns the number of spans sent, counted from the first one
+    uint32_t sendBatch(const LocIpcSpan spans[], uint32_t count, int flags,
+                       const struct sockaddr *destAddr, socklen_t addrlen) const;
     ssize_t sendAbort(int flags, const struct sockaddr *destAddr, socklen_t addrlen);
     inline void close() {
         if (isValid()) {
@@ -234,6 +365,7 @@ public:
         return "SockRecver";
     }
     inline virtual void abort() const override {}
+    inline virtual int getPollFd() const override { return mSock->mSid; }
 };
 
 }
@@ -0,0 +1,616 @@
+/* Copyright (c) 2020 The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <log_util.h>
+#include <LocIpc.h>
+
+using namespace std;
+
+namespace loc_util {
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#endif
+#define LOG_TAG "LocSvc_LocIpcShm"
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+/*
+Shared memory transport, for high rate local consumers.
+
+The sender owns a memfd backed single producer single consumer ring. It
+connects to the SOCK_SEQPACKET socket the recver listens on, and hands it the
+memfd and two eventfd doorbells with SCM_RIGHTS: one the recver waits on for
+data, one the sender waits on for space when the ring is full. After that,
+messages are written straight into the ring and read by the recver where
+they are, with no copy through the kernel. Either side only rings a doorbell
+if the other announced that it is about to wait on it. The connection is only
+used to tell the recver when the sender goes away.
+
+Ring records are a uint32_t length followed by the message and a byte the
+recver sets to NUL before handing the message over, 8 byte aligned. A record
+never wraps around the end of the ring; a length of kWrapMark tells the
+reader to go on from the start.
+*/
+
+static const uint32_t kShmMagic = 0x4c495352; // "LISR"
+static const uint32_t kShmVersion = 2;
+static const uint32_t kWrapMark = 0xFFFFFFFF;
+static const int kShmSendTimeoutMs = 2000;
+
+struct LocIpcShmHeader {
+    uint32_t mMagic;
+    uint32_t mVersion;
+    uint32_t mCapacity;           // bytes of record space, power of 2
+    // written by the sender
+    alignas(64) atomic<uint64_t> mHead;
+    atomic<uint32_t> mSenderWaiting;
+    // written by the recver
+    alignas(64) atomic<uint64_t> mTail;
+    atomic<uint32_t> mRecverWaiting;
+};
+
+// what the sender sends along with the fds
+struct LocIpcShmHello {
+    uint32_t mMagic;
+    uint32_t mVersion;
+    uint32_t mMapSize;
+};
+
+static inline uint32_t recordSize(uint32_t len) {
+    return (sizeof(uint32_t) + len + 1 + 7) & ~7U;
+}
+
+static inline void ringDoorbell(int fd) {
+    uint64_t one = 1;
+    if (write(fd, &one, sizeof(one)) < 0) {
+        LOC_LOGw("doorbell failed: %s", strerror(errno));
+    }
+}
+
+static inline void drainDoorbell(int fd) {
+    uint64_t count;
+    while (read(fd, &count, sizeof(count)) > 0);
+}
+
+class LocIpcShmSender : public LocIpcSender {
+protected:
+    const string mName;
+    const uint32_t mCapacity;
+    mutable mutex mMutex;
+    // set up on the first send
+    mutable int mSockFd;
+    mutable int mDataFd;
+    mutable int mSpaceFd;
+    mutable LocIpcShmHeader* mHeader;
+    mutable size_t mMapSize;
+
+    inline virtual bool isOperable() const override { return !mName.empty(); }
+    bool connectLocked() const;
+    void disconnectLocked() const;
+    bool waitForSpaceLocked(uint32_t need) const;
+    virtual ssize_t send(const uint8_t data[], uint32_t length, int32_t msgId) const override;
+public:
+    LocIpcShmSender(const char* name, uint32_t ringSize);
+    virtual ~LocIpcShmSender();
+};
+
+LocIpcShmSender::LocIpcShmSender(const char* name, uint32_t ringSize) :
+        LocIpcSender(), mName((nullptr == name) ? "" : name), mCapacity([ringSize] {
+            uint32_t capacity = 4096;
+            while (capacity < ringSize && capacity < (1U << 30)) {
+                capacity <<= 1;
+            }
+            return capacity;
+        }()),
+        mSockFd(-1), mDataFd(-1), mSpaceFd(-1), mHeader(nullptr), mMapSize(0) {
+}
+
+LocIpcShmSender::~LocIpcShmSender() {
+    lock_guard<mutex> lock(mMutex);
+    disconnectLocked();
+}
+
+void LocIpcShmSender::disconnectLocked() const {
+    if (nullptr != mHeader) {
+        munmap(mHeader, mMapSize);
+        mHeader = nullptr;
+    }
+    for (int* fd : {&mSockFd, &mDataFd, &mSpaceFd}) {
+        if (-1 != *fd) {
+            ::close(*fd);
+            *fd = -1;
+        }
+    }
+}
+
+bool LocIpcShmSender::connectLocked() const {
+    struct sockaddr_un addr = {.sun_family = AF_UNIX, {}};
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", mName.c_str());
+    mSockFd = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    int memFd = -1;
+    bool success = false;
+    if (mSockFd >= 0 && ::connect(mSockFd, (struct sockaddr*)&addr, sizeof(addr)) == 0) {
+        mMapSize = sizeof(LocIpcShmHeader) + mCapacity;
+        memFd = syscall(__NR_memfd_create, "LocIpcShm", MFD_CLOEXEC);
+        mDataFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        mSpaceFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (memFd >= 0 && mDataFd >= 0 && mSpaceFd >= 0 && ftruncate(memFd, mMapSize) == 0) {
+            void* map = mmap(nullptr, mMapSize, PROT_READ | PROT_WRITE, MAP_SHARED, memFd, 0);
+            if (MAP_FAILED != map) {
+                mHeader = new (map) LocIpcShmHeader();
+                mHeader->mMagic = kShmMagic;
+                mHeader->mVersion = kShmVersion;
+                mHeader->mCapacity = mCapacity;
+                mHeader->mHead.store(0);
+                mHeader->mTail.store(0);
+                mHeader->mSenderWaiting.store(0);
+                mHeader->mRecverWaiting.store(0);
+
+                LocIpcShmHello hello = {kShmMagic, kShmVersion, (uint32_t)mMapSize};
+                int fds[3] = {memFd, mDataFd, mSpaceFd};
+                char control[CMSG_SPACE(sizeof(fds))];
+                memset(control, 0, sizeof(control));
+                struct iovec iov = {&hello, sizeof(hello)};
+                struct msghdr msg;
+                memset(&msg, 0, sizeof(msg));
+                msg.msg_iov = &iov;
+                msg.msg_iovlen = 1;
+                msg.msg_control = control;
+                msg.msg_controllen = sizeof(control);
+                struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+                cmsg->cmsg_level = SOL_SOCKET;
+                cmsg->cmsg_type = SCM_RIGHTS;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+                memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+                success = (::sendmsg(mSockFd, &msg, MSG_NOSIGNAL) == (ssize_t)sizeof(hello));
+            }
+        }
+    }
+    if (memFd >= 0) {
+        // the mapping and the recver keep the memory
+        ::close(memFd);
+    }
+    if (!success) {
+        LOC_LOGe("failed to set up ring with %s: %s", mName.c_str(), strerror(errno));
+        disconnectLocked();
+    }
+    return success;
+}
+
+// waits, up to kShmSendTimeoutMs, until the recver has freed need bytes
+bool LocIpcShmSender::waitForSpaceLocked(uint32_t need) const {
+    for (;;) {
+        uint64_t used = mHeader->mHead.load(memory_order_relaxed) -
+                        mHeader->mTail.load(memory_order_acquire);
+        if (mCapacity - used >= need) {
+            return true;
+        }
+        mHeader->mSenderWaiting.store(1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        used = mHeader->mHead.load(memory_order_relaxed) -
+               mHeader->mTail.load(memory_order_acquire);
+        if (mCapacity - used >= need) {
+            mHeader->mSenderWaiting.store(0, memory_order_relaxed);
+            return true;
+        }
+        struct pollfd fds[2] = {{mSpaceFd, POLLIN, 0}, {mSockFd, 0, 0}};
+        int rtv = poll(fds, 2, kShmSendTimeoutMs);
+        mHeader->mSenderWaiting.store(0, memory_order_relaxed);
+        if (rtv <= 0 || (fds[1].revents & (POLLHUP | POLLERR))) {
+            return false;
+        }
+        drainDoorbell(mSpaceFd);
+    }
+}
+
+ssize_t LocIpcShmSender::send(const uint8_t data[], uint32_t length, int32_t /* msgId */) const {
+    if (nullptr == data || 0 == length) {
+        LOC_LOGe("Invalid inputs: buf - %p, length - %u", data, length);
+        return -1;
+    }
+    // a record may have to skip the end of the ring
+    if (length > mCapacity / 2 || recordSize(length) > mCapacity / 2) {
+        LOC_LOGe("message of %u bytes does not fit in a ring of %u", length, mCapacity);
+        return -1;
+    }
+
+    lock_guard<mutex> lock(mMutex);
+    if (nullptr == mHeader && !connectLocked()) {
+        return -1;
+    }
+
+    uint32_t need = recordSize(length);
+    uint64_t head = mHeader->mHead.load(memory_order_relaxed);
+    uint32_t offset = head & (mCapacity - 1);
+    uint32_t toEnd = mCapacity - offset;
+    if (need > toEnd) {
+        need += toEnd;
+    }
+    if (!waitForSpaceLocked(need)) {
+        LOC_LOGw("%s is gone or not reading, dropping connection", mName.c_str());
+        disconnectLocked();
+        return -1;
+    }
+
+    uint8_t* ring = (uint8_t*)(mHeader + 1);
+    if (need > recordSize(length)) {
+        memcpy(ring + offset, &kWrapMark, sizeof(kWrapMark));
+        offset = 0;
+    }
+    memcpy(ring + offset, &length, sizeof(length));
+    memcpy(ring + offset + sizeof(length), data, length);
+    mHeader->mHead.store(head + need, memory_order_release);
+
+    atomic_thread_fence(memory_order_seq_cst);
+    if (mHeader->mRecverWaiting.load(memory_order_relaxed)) {
+        ringDoorbell(mDataFd);
+    }
+    return length;
+}
+
+class LocIpcShmRecver : public LocIpcShmSender, public LocIpcRecver {
+    // one ring per connected sender. The sender can write all of the mapping
+    // at any time, so what the recver relies on, the capacity it validated and
+    // where it is reading, is kept here and never read back from it.
+    struct Ring {
+        int mSockFd;
+        int mDataFd;
+        int mSpaceFd;
+        LocIpcShmHeader* mHeader;
+        size_t mMapSize;
+        uint32_t mCapacity;
+        uint64_t mTail;
+        bool mGone;
+    };
+    static const int kMaxEvents = 16;
+    static const size_t kMaxPending = 4;
+    int mListenFd;
+    int mAbortFd;
+    // the abort and listening fds, the connections yet to send their hello,
+    // and the doorbell and connection of each ring
+    int mEpollFd;
+    mutable vector<Ring> mRings;
+    mutable vector<int> mPending;
+
+    void acceptRing() const;
+    bool setUpRing(int sockFd) const;
+    void closeRing(size_t index) const;
+    bool drainRing(Ring& ring) const;
+    void drainRings() const;
+    bool armRings() const;
+protected:
+    virtual ssize_t recv() const override;
+    inline virtual bool isOperable() const override { return -1 != mListenFd; }
+public:
+    LocIpcShmRecver(const shared_ptr<ILocIpcListener>& listener, const char* name);
+    virtual ~LocIpcShmRecver();
+    inline virtual const char* getName() const override { return mName.c_str(); }
+    inline virtual void abort() const override {
+        if (-1 != mAbortFd) {
+            ringDoorbell(mAbortFd);
+        }
+    }
+    inline virtual int getPollFd() const override { return mEpollFd; }
+};
+
+LocIpcShmRecver::LocIpcShmRecver(const shared_ptr<ILocIpcListener>& listener, const char* name) :
+        LocIpcShmSender(name, 0), LocIpcRecver(listener, *this),
+        mListenFd(-1), mAbortFd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)),
+        mEpollFd(epoll_create1(EPOLL_CLOEXEC)) {
+    struct sockaddr_un addr = {.sun_family = AF_UNIX, {}};
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", mName.c_str());
+    if ((unlink(addr.sun_path) < 0) && (errno != ENOENT)) {
+        LOC_LOGw("unlink socket error. reason:%s", strerror(errno));
+    }
+    if (!mName.empty() && -1 != mAbortFd && -1 != mEpollFd) {
+        mListenFd = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        umask(0157);
+        if (mListenFd >= 0 &&
+            (::bind(mListenFd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+             ::listen(mListenFd, 4) < 0)) {
+            LOC_LOGe("bind socket error. sock fd: %d: %s, reason: %s", mListenFd,
+                     addr.sun_path, strerror(errno));
+            ::close(mListenFd);
+            mListenFd = -1;
+        }
+    }
+    for (int fd : {mAbortFd, mListenFd}) {
+        struct epoll_event ev = {.events = EPOLLIN, .data = {.fd = fd}};
+        if (-1 != fd && -1 != mEpollFd && epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            LOC_LOGe("epoll_ctl failed: %s", strerror(errno));
+        }
+    }
+}
+
+LocIpcShmRecver::~LocIpcShmRecver() {
+    while (!mRings.empty()) {
+        closeRing(mRings.size() - 1);
+    }
+    for (int fd : mPending) {
+        ::close(fd);
+    }
+    if (-1 != mListenFd) {
+        ::close(mListenFd);
+        unlink(mName.c_str());
+    }
+    if (-1 != mAbortFd) {
+        ::close(mAbortFd);
+    }
+    if (-1 != mEpollFd) {
+        ::close(mEpollFd);
+    }
+}
+
+// accepts a sender without waiting for its hello: the connection is set up
+// by setUpRing() once the hello is there, so that a client that never sends
+// it cannot stall the recver
+void LocIpcShmRecver::acceptRing() const {
+    int sockFd = accept4(mListenFd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+    if (sockFd < 0) {
+        return;
+    }
+    if (!setUpRing(sockFd)) {
+        if (mPending.size() >= kMaxPending) {
+            LOC_LOGw("%s: too many senders yet to set up their ring", mName.c_str());
+            epoll_ctl(mEpollFd, EPOLL_CTL_DEL, mPending.front(), nullptr);
+            ::close(mPending.front());
+            mPending.erase(mPending.begin());
+        }
+        struct epoll_event ev = {.events = EPOLLIN, .data = {.fd = sockFd}};
+        epoll_ctl(mEpollFd, EPOLL_CTL_ADD, sockFd, &ev);
+        mPending.push_back(sockFd);
+    }
+}
+
+// reads the hello of a sender and maps its ring; returns false if the hello
+// is not there yet, true once sockFd is either used for the ring or closed
+bool LocIpcShmRecver::setUpRing(int sockFd) const {
+    LocIpcShmHello hello;
+    memset(&hello, 0, sizeof(hello));
+    int fds[3] = {-1, -1, -1};
+    char control[CMSG_SPACE(sizeof(fds))];
+    struct iovec iov = {&hello, sizeof(hello)};
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t len = ::recvmsg(sockFd, &msg, MSG_CMSG_CLOEXEC);
+    if (len < 0 && (EAGAIN == errno || EWOULDBLOCK == errno)) {
+        return false;
+    }
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (len > 0 && nullptr != cmsg && SOL_SOCKET == cmsg->cmsg_level &&
+        SCM_RIGHTS == cmsg->cmsg_type && cmsg->cmsg_len == CMSG_LEN(sizeof(fds))) {
+        memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+    }
+
+    Ring ring = {sockFd, fds[1], fds[2], nullptr, hello.mMapSize, 0, 0, false};
+    struct stat st;
+    if (len == (ssize_t)sizeof(hello) && kShmMagic == hello.mMagic &&
+        kShmVersion == hello.mVersion && fds[0] >= 0 && fds[1] >= 0 && fds[2] >= 0 &&
+        hello.mMapSize > sizeof(LocIpcShmHeader) &&
+        fstat(fds[0], &st) == 0 && st.st_size >= (off_t)hello.mMapSize) {
+        void* map = mmap(nullptr, hello.mMapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+        if (MAP_FAILED != map) {
+            ring.mHeader = (LocIpcShmHeader*)map;
+            ring.mCapacity = ring.mHeader->mCapacity;
+            ring.mTail = ring.mHeader->mTail.load(memory_order_relaxed);
+            // the capacity must be a power of 2 that fits in the mapping, and the
+            // tail where a record starts
+            if (ring.mCapacity < 8 || 0 != (ring.mCapacity & (ring.mCapacity - 1)) ||
+                sizeof(LocIpcShmHeader) + ring.mCapacity > hello.mMapSize ||
+                0 != (ring.mTail & 7)) {
+                munmap(map, hello.mMapSize);
+                ring.mHeader = nullptr;
+            }
+        }
+    }
+    if (fds[0] >= 0) {
+        ::close(fds[0]);
+    }
+
+    if (nullptr == ring.mHeader) {
+        LOC_LOGe("%s: bad ring set up from sender", mName.c_str());
+        epoll_ctl(mEpollFd, EPOLL_CTL_DEL, sockFd, nullptr);
+        for (int fd : {sockFd, fds[1], fds[2]}) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+        }
+    } else {
+        for (int fd : {ring.mSockFd, ring.mDataFd}) {
+            struct epoll_event ev = {.events = EPOLLIN, .data = {.fd = fd}};
+            if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &ev) < 0 && EEXIST == errno) {
+                epoll_ctl(mEpollFd, EPOLL_CTL_MOD, fd, &ev);
+            }
+        }
+        mRings.push_back(ring);
+    }
+    return true;
+}
+
+void LocIpcShmRecver::closeRing(size_t index) const {
+    Ring& ring = mRings[index];
+    epoll_ctl(mEpollFd, EPOLL_CTL_DEL, ring.mSockFd, nullptr);
+    epoll_ctl(mEpollFd, EPOLL_CTL_DEL, ring.mDataFd, nullptr);
+    munmap(ring.mHeader, ring.mMapSize);
+    ::close(ring.mSockFd);
+    ::close(ring.mDataFd);
+    ::close(ring.mSpaceFd);
+    mRings.erase(mRings.begin() + index);
+}
+
+// hands all the records in the ring to the listener, in place and NUL
+// terminated. returns false if the ring is corrupt
+bool LocIpcShmRecver::drainRing(Ring& ring) const {
+    LocIpcShmHeader* header = ring.mHeader;
+    const uint32_t capacity = ring.mCapacity;
+    uint8_t* records = (uint8_t*)(header + 1);
+    uint64_t tail = ring.mTail;
+    uint64_t head = header->mHead.load(memory_order_acquire);
+    while (tail != head) {
+        if (head - tail > capacity) {
+            return false;
+        }
+        uint32_t offset = tail & (capacity - 1);
+        uint32_t length;
+        memcpy(&length, records + offset, sizeof(length));
+        if (kWrapMark == length) {
+            tail += capacity - offset;
+        } else {
+            // room for the length, the message and its NUL; checked before
+            // recordSize(), which a length close to 4G would overflow
+            if (length >= capacity - offset - sizeof(length)) {
+                return false;
+            }
+            char* data = (char*)records + offset + sizeof(length);
+            data[length] = 0;
+            if (mDataCb->wantsOwnership()) {
+                mDataCb->onReceiveOwned(string(data, length), this);
+            } else {
+                mDataCb->onReceive(data, length, this);
+            }
+            tail += recordSize(length);
+        }
+        ring.mTail = tail;
+        header->mTail.store(tail, memory_order_release);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (header->mSenderWaiting.load(memory_order_relaxed)) {
+            ringDoorbell(ring.mSpaceFd);
+        }
+        head = header->mHead.load(memory_order_acquire);
+    }
+    return true;
+}
+
+// drains every ring, dropping the corrupt ones and those whose sender is gone
+void LocIpcShmRecver::drainRings() const {
+    // walk backwards, rings may be closed along the way
+    for (size_t i = mRings.size(); i > 0; i--) {
+        Ring& ring = mRings[i - 1];
+        ring.mHeader->mRecverWaiting.store(0, memory_order_relaxed);
+        if (!drainRing(ring)) {
+            LOC_LOGe("%s: corrupt ring, dropping sender", mName.c_str());
+            closeRing(i - 1);
+        } else if (ring.mGone) {
+            closeRing(i - 1);
+        }
+    }
+}
+
+// announces to every sender that the next wait is on its doorbell; returns
+// false if a ring got a message meanwhile, which then has to be drained first
+bool LocIpcShmRecver::armRings() const {
+    for (auto& ring : mRings) {
+        ring.mHeader->mRecverWaiting.store(1, memory_order_relaxed);
+    }
+    atomic_thread_fence(memory_order_seq_cst);
+    for (auto& ring : mRings) {
+        if (ring.mHeader->mHead.load(memory_order_acquire) != ring.mTail) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// One round of waiting: returns 0 once aborted, > 0 otherwise. The rings
+// are left armed, so that the epoll fd polls readable as soon as any sender
+// has something, also when waited on by a LocIpcReactor.
+ssize_t LocIpcShmRecver::recv() const {
+    struct epoll_event events[kMaxEvents];
+    int count = epoll_wait(mEpollFd, events, kMaxEvents, -1);
+    if (count < 0 && EINTR != errno) {
+        LOC_LOGe("epoll_wait failed: %s", strerror(errno));
+        return -1;
+    }
+
+    bool pending = false;
+    for (int i = 0; i < count; i++) {
+        int fd = events[i].data.fd;
+        if (fd == mAbortFd) {
+            LOC_LOGi("recvd abort on %s", mName.c_str());
+            drainDoorbell(mAbortFd);
+            return 0;
+        } else if (fd == mListenFd) {
+            pending = true;
+        } else if (find(mPending.begin(), mPending.end(), fd) != mPending.end()) {
+            if (setUpRing(fd)) {
+                mPending.erase(find(mPending.begin(), mPending.end(), fd));
+            }
+        } else {
+            for (auto& ring : mRings) {
+                if (fd == ring.mSockFd) {
+                    // nothing is ever sent on it but the hang up
+                    ring.mGone = true;
+                } else if (fd == ring.mDataFd) {
+                    drainDoorbell(fd);
+                }
+            }
+        }
+    }
+
+    drainRings();
+    if (pending) {
+        acceptRing();
+    }
+    while (!armRings()) {
+        drainRings();
+    }
+    return 1;
+}
+
+shared_ptr<LocIpcSender> LocIpc::getLocIpcShmSender(const char* shmSockName, uint32_t ringSize) {
+    return make_shared<LocIpcShmSender>(shmSockName, ringSize);
+}
+
+unique_ptr<LocIpcRecver> LocIpc::getLocIpcShmRecver(const shared_ptr<ILocIpcListener>& listener,
+                                                    const char* shmSockName) {
+    return make_unique<LocIpcShmRecver>(listener, shmSockName);
+}
+
+} // namespace loc_util
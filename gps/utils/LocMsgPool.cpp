@@ -0,0 +1,116 @@
+/* Copyright (c) 2020 The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#define LOG_NDEBUG 0
+#define LOG_TAG "LocSvc_MsgPool"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <LocMsgPool.h>
+#include <log_util.h>
+
+namespace loc_util {
+
+static pthread_mutex_t sPoolListMutex = PTHREAD_MUTEX_INITIALIZER;
+static LocMsgPoolBase* sPoolList = nullptr;
+
+LocMsgPoolBase::LocMsgPoolBase(const char* name, size_t blockSize, uint32_t maxFree) :
+    mName(name), mBlockSize(blockSize), mMaxFree(maxFree),
+    mMutex(PTHREAD_MUTEX_INITIALIZER), mFreeList(nullptr), mFreeCount(0),
+    mHits(0), mMisses(0), mRecycled(0), mReleased(0), mNextPool(nullptr) {
+    pthread_mutex_lock(&sPoolListMutex);
+    mNextPool = sPoolList;
+    sPoolList = this;
+    pthread_mutex_unlock(&sPoolListMutex);
+}
+
+void* LocMsgPoolBase::alloc(size_t size) {
+    FreeBlock* block = nullptr;
+    if (size == mBlockSize) {
+        pthread_mutex_lock(&mMutex);
+        if (nullptr != mFreeList) {
+            block = mFreeList;
+            mFreeList = block->mNext;
+            mFreeCount--;
+            mHits++;
+        } else {
+            mMisses++;
+        }
+        pthread_mutex_unlock(&mMutex);
+    }
+    return (nullptr != block) ? (void*)block : ::operator new(size);
+}
+
+void LocMsgPoolBase::free(void* ptr, size_t size) {
+    if (nullptr == ptr) {
+        return;
+    }
+    bool recycled = false;
+    if (size == mBlockSize) {
+        pthread_mutex_lock(&mMutex);
+        if (mFreeCount < mMaxFree) {
+            FreeBlock* block = (FreeBlock*)ptr;
+            block->mNext = mFreeList;
+            mFreeList = block;
+            mFreeCount++;
+            mRecycled++;
+            recycled = true;
+        } else {
+            mReleased++;
+        }
+        pthread_mutex_unlock(&mMutex);
+    }
+    if (!recycled) {
+        ::operator delete(ptr);
+    }
+}
+
+LocMsgPoolStats LocMsgPoolBase::getStats() {
+    pthread_mutex_lock(&mMutex);
+    LocMsgPoolStats stats = {mName, mBlockSize, mHits, mMisses, mRecycled, mReleased,
+                             mFreeCount, mMaxFree};
+    pthread_mutex_unlock(&mMutex);
+    return stats;
+}
+
+void LocMsgPoolBase::dump(std::string& out) {
+    char line[256];
+    pthread_mutex_lock(&sPoolListMutex);
+    for (LocMsgPoolBase* pool = sPoolList; nullptr != pool; pool = pool->mNextPool) {
+        LocMsgPoolStats stats = pool->getStats();
+        snprintf(line, sizeof(line),
+                 "%s: size %zu hit %" PRIu64 " miss %" PRIu64 " recycled %" PRIu64
+                 " released %" PRIu64 " free %u/%u\n",
+                 stats.mName, stats.mBlockSize, stats.mHits, stats.mMisses,
+                 stats.mRecycled, stats.mReleased, stats.mFreeCount, stats.mMaxFree);
+        out.append(line);
+    }
+    pthread_mutex_unlock(&sPoolListMutex);
+}
+
+} // namespace loc_util
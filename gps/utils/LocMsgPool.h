@@ -0,0 +1,106 @@
+/* Copyright (c) 2020 The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef __LOC_MSG_POOL__
+#define __LOC_MSG_POOL__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <new>
+#include <string>
+
+namespace loc_util {
+
+struct LocMsgPoolStats {
+    const char* mName;
+    size_t mBlockSize;
+    uint64_t mHits;       // allocations served from the free list
+    uint64_t mMisses;     // allocations that went to the general heap
+    uint64_t mRecycled;   // deallocations kept in the free list
+    uint64_t mReleased;   // deallocations given back to the general heap
+    uint32_t mFreeCount;  // blocks currently in the free list
+    uint32_t mMaxFree;    // bound of the free list
+};
+
+// Type independent part of LocMsgPool<T>. All pools register themselves
+// here so that their stats can be dumped together.
+class LocMsgPoolBase {
+    struct FreeBlock {
+        FreeBlock* mNext;
+    };
+    const char* mName;
+    const size_t mBlockSize;
+    const uint32_t mMaxFree;
+    pthread_mutex_t mMutex;
+    FreeBlock* mFreeList;
+    uint32_t mFreeCount;
+    uint64_t mHits;
+    uint64_t mMisses;
+    uint64_t mRecycled;
+    uint64_t mReleased;
+    LocMsgPoolBase* mNextPool;
+protected:
+    LocMsgPoolBase(const char* name, size_t blockSize, uint32_t maxFree);
+    // pools live as long as the process, blocks may be freed at exit
+    inline ~LocMsgPoolBase() {}
+public:
+    void* alloc(size_t size);
+    void free(void* block, size_t size);
+    LocMsgPoolStats getStats();
+    // appends one line of stats per registered pool
+    static void dump(std::string& out);
+};
+
+// Per type pool of LocMsg blocks, with a bounded free list. A LocMsg
+// subclass opts in with LOC_MSG_POOL(), which binds its class level
+// operator new / operator delete to LocMsgPool<T>.
+// Allocations of a size other than sizeof(T), e.g. of a subclass, go to
+// the general heap.
+template <typename T>
+class LocMsgPool : public LocMsgPoolBase {
+    inline LocMsgPool(const char* name, uint32_t maxFree) :
+        LocMsgPoolBase(name, sizeof(T), maxFree) {}
+public:
+    inline static LocMsgPool<T>& getInstance(const char* name, uint32_t maxFree) {
+        static LocMsgPool<T>* pool = new LocMsgPool<T>(name, maxFree);
+        return *pool;
+    }
+};
+
+} // namespace loc_util
+
+#define LOC_MSG_POOL(Type, maxFree)                                                   \
+    inline static void* operator new(size_t size) {                                  \
+        return loc_util::LocMsgPool<Type>::getInstance(#Type, (maxFree)).alloc(size); \
+    }                                                                                 \
+    inline static void operator delete(void* block, size_t size) {                   \
+        loc_util::LocMsgPool<Type>::getInstance(#Type, (maxFree)).free(block, size); \
+    }
+
+#endif //__LOC_MSG_POOL__
@@ -0,0 +1,128 @@
+/* Copyright (c) 2020 The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#define LOG_NDEBUG 0
+#define LOG_TAG "LocSvc_StrandPool"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <deque>
+#include <LocStrandPool.h>
+#include <MsgTask.h>
+#include <log_util.h>
+#include <loc_pla.h>
+
+namespace loc_util {
+
+class LocStrandRunQueue {
+    pthread_mutex_t mMutex;
+    pthread_cond_t mCond;
+    std::deque<const MsgTask*> mStrands;
+    bool mStopped;
+public:
+    inline LocStrandRunQueue() : mMutex(PTHREAD_MUTEX_INITIALIZER),
+        mCond(PTHREAD_COND_INITIALIZER), mStopped(false) {}
+    inline ~LocStrandRunQueue() {
+        pthread_cond_destroy(&mCond);
+        pthread_mutex_destroy(&mMutex);
+    }
+    inline void push(const MsgTask* strand) {
+        pthread_mutex_lock(&mMutex);
+        mStrands.push_back(strand);
+        pthread_cond_signal(&mCond);
+        pthread_mutex_unlock(&mMutex);
+    }
+    // blocks until a strand is queued; nullptr once stopped
+    inline const MsgTask* pop() {
+        const MsgTask* strand = nullptr;
+        pthread_mutex_lock(&mMutex);
+        while (mStrands.empty() && !mStopped) {
+            pthread_cond_wait(&mCond, &mMutex);
+        }
+        if (!mStopped) {
+            strand = mStrands.front();
+            mStrands.pop_front();
+        }
+        pthread_mutex_unlock(&mMutex);
+        return strand;
+    }
+    inline void stop() {
+        pthread_mutex_lock(&mMutex);
+        mStopped = true;
+        pthread_cond_broadcast(&mCond);
+        pthread_mutex_unlock(&mMutex);
+    }
+};
+
+class LocStrandWorker : public LocRunnable {
+    std::shared_ptr<LocStrandRunQueue> mRunQueue;
+public:
+    inline LocStrandWorker(const std::shared_ptr<LocStrandRunQueue>& runQueue) :
+        mRunQueue(runQueue) {}
+    virtual bool run() override {
+        const MsgTask* strand = mRunQueue->pop();
+        if (nullptr == strand) {
+            return false;
+        }
+        strand->runStrand();
+        return true;
+    }
+    virtual void prerun() override {
+        // make sure we do not run in background scheduling group
+        set_sched_policy(gettid(), SP_FOREGROUND);
+    }
+    virtual void interrupt() override { mRunQueue->stop(); }
+};
+
+LocStrandPool::LocStrandPool(const char* threadName, uint32_t numThreads,
+                             const LocThreadAttr& threadAttr) :
+    mRunQueue(std::make_shared<LocStrandRunQueue>()),
+    mThreads(new LocThread[numThreads > 0 ? numThreads : 1]),
+    mNumThreads(numThreads > 0 ? numThreads : 1), mTimerTask(nullptr) {
+    char name[16];
+    snprintf(name, sizeof(name), "%.12s_tmr", threadName ? threadName : "LocStrand");
+    mTimerTask = new MsgTask(name);
+    for (uint32_t i = 0; i < mNumThreads; i++) {
+        snprintf(name, sizeof(name), "%.12s_%u", threadName ? threadName : "LocStrand", i);
+        mThreads[i].start(name, std::make_shared<LocStrandWorker>(mRunQueue), threadAttr);
+    }
+    LOC_LOGd("%u workers", mNumThreads);
+}
+
+LocStrandPool::~LocStrandPool() {
+    delete mTimerTask;
+    mRunQueue->stop();
+    delete[] mThreads;
+}
+
+void LocStrandPool::schedule(const MsgTask* strand) const {
+    mRunQueue->push(strand);
+}
+
+} // namespace loc_util
@@ -0,0 +1,65 @@
+/* Copyright (c) 2020 The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef __LOC_STRAND_POOL__
+#define __LOC_STRAND_POOL__
+
+#include <stdint.h>
+#include <memory>
+#include <LocThread.h>
+
+namespace loc_util {
+
+class MsgTask;
+class LocStrandRunQueue;
+
+// A small pool of worker threads running strands, i.e. MsgTasks created with
+// MsgTask(LocStrandPool&). Msgs of one strand are processed one at a time in
+// order, while different strands run in parallel. A strand with pending msgs
+// sits in a FIFO run queue; a worker takes it, processes one batch of its msgs
+// and queues it again at the back if it still has msgs, so strands are served
+// round robin.
+class LocStrandPool {
+    std::shared_ptr<LocStrandRunQueue> mRunQueue;
+    LocThread* mThreads;
+    const uint32_t mNumThreads;
+    MsgTask* mTimerTask;
+public:
+    LocStrandPool(const char* threadName, uint32_t numThreads,
+                  const LocThreadAttr& threadAttr = LocThreadAttr());
+    ~LocStrandPool();
+    // queues strand to be run by a worker, called by MsgTask
+    void schedule(const MsgTask* strand) const;
+    // thread holding delayed msgs of the strands until due, see
+    // MsgTask::sendMsgAt()
+    inline const MsgTask& getTimerTask() const { return *mTimerTask; }
+};
+
+} // namespace loc_util
+
+#endif //__LOC_STRAND_POOL__
@@ -26,25 +26,128 @@
  * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  *
  */
+#define LOG_NDEBUG 0
+#define LOG_TAG "LocSvc_LocThread"
+
 #include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sched.h>
+#include <pthread.h>
+#include <errno.h>
+#include <inttypes.h>
 #include <LocThread.h>
 #include <string.h>
 #include <string>
-#include <thread>
 #include <loc_pla.h>
+#include <loc_cfg.h>
+#include <log_util.h>
 
 using std::weak_ptr;
 using std::shared_ptr;
-using std::thread;
 using std::string;
 
 namespace loc_util {
 
+LocThreadAttr LocThreadAttr::fromConf(const char* role) {
+    LocThreadAttr attr;
+    uint32_t cpuMask = 0;
+    uint32_t policy = 0;
+    int32_t priority = 0;
+    uint32_t stackKb = 0;
+    uint32_t timerSlackUs = 0;
+    uint8_t policySet = 0;
+    uint8_t prioritySet = 0;
+    const string prefix(role);
+    const string cpuMaskName(prefix + "_THREAD_CPU_MASK");
+    const string policyName(prefix + "_THREAD_SCHED_POLICY");
+    const string priorityName(prefix + "_THREAD_PRIORITY");
+    const string stackName(prefix + "_THREAD_STACK_KB");
+    const string timerSlackName(prefix + "_THREAD_TIMER_SLACK_US");
+    const loc_param_s_type thread_conf_param_table[] =
+    {
+        {cpuMaskName.c_str(),    &cpuMask,      NULL,         'n'},
+        {policyName.c_str(),     &policy,       &policySet,   'n'},
+        {priorityName.c_str(),   &priority,     &prioritySet, 'n'},
+        {stackName.c_str(),      &stackKb,      NULL,         'n'},
+        {timerSlackName.c_str(), &timerSlackUs, NULL,         'n'},
+    };
+    UTIL_READ_CONF(LOC_PATH_GPS_CONF, thread_conf_param_table);
+
+    attr.mCpuMask = cpuMask;
+    if (policySet || prioritySet) {
+        attr.mPolicy = (1 == policy) ? SCHED_FIFO : SCHED_OTHER;
+        attr.mPriority = priority;
+    }
+    attr.mStackSize = (size_t)stackKb * 1024;
+    attr.mTimerSlackNs = (uint64_t)timerSlackUs * 1000;
+    return attr;
+}
+
+// Applies attr, except for the stack size, to the calling thread
+static void applyThreadAttr(const char* name, const LocThreadAttr& attr) {
+    if (0 != attr.mCpuMask) {
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        for (uint32_t cpu = 0; cpu < 32; cpu++) {
+            if (attr.mCpuMask & (1u << cpu)) {
+                CPU_SET(cpu, &cpuSet);
+            }
+        }
+        if (0 != sched_setaffinity(0, sizeof(cpuSet), &cpuSet)) {
+            LOC_LOGe("%s: sched_setaffinity 0x%x failed - %s",
+                     name, attr.mCpuMask, strerror(errno));
+        }
+    }
+    if (SCHED_FIFO == attr.mPolicy) {
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = attr.mPriority;
+        if (0 != sched_setscheduler(0, SCHED_FIFO, &param)) {
+            LOC_LOGe("%s: SCHED_FIFO priority %d failed - %s",
+                     name, attr.mPriority, strerror(errno));
+        }
+    } else if (SCHED_OTHER == attr.mPolicy) {
+        if (0 != setpriority(PRIO_PROCESS, syscall(SYS_gettid), attr.mPriority)) {
+            LOC_LOGe("%s: nice %d failed - %s", name, attr.mPriority, strerror(errno));
+        }
+    }
+    if (0 != attr.mTimerSlackNs) {
+        prctl(PR_SET_TIMERSLACK, (unsigned long)attr.mTimerSlackNs, 0, 0, 0);
+    }
+    LOC_LOGd("%s: cpu mask 0x%x policy %d priority %d stack %zu timer slack %" PRIu64 "ns",
+             name, attr.mCpuMask, attr.mPolicy, attr.mPriority, attr.mStackSize,
+             attr.mTimerSlackNs);
+}
+
+void LocWakeupJitter::add(int64_t lateNs) {
+    if (lateNs < 0) {
+        lateNs = 0;
+    }
+    mCount++;
+    mTotalNs += lateNs;
+    if ((uint64_t)lateNs > mMaxNs) {
+        mMaxNs = lateNs;
+    }
+    if (mCount >= kLogInterval) {
+        LOC_LOGi("%s wakeup jitter over %u wakeups: avg %" PRIu64 " us, max %" PRIu64 " us",
+                 mName, mCount, mTotalNs / mCount / 1000, mMaxNs / 1000);
+        mCount = 0;
+        mTotalNs = 0;
+        mMaxNs = 0;
+    }
+}
+
 class LocThreadDelegate {
     static const char defaultThreadName[];
     weak_ptr<LocRunnable> mRunnable;
-    thread mThread;
-    LocThreadDelegate(const string tName, shared_ptr<LocRunnable> r);
+    struct ThreadArgs {
+        string mName;
+        shared_ptr<LocRunnable> mRunnable;
+        LocThreadAttr mAttr;
+    };
+    LocThreadDelegate(shared_ptr<LocRunnable> r) : mRunnable(r) {}
+    static void* threadMain(void* arg);
 public:
     ~LocThreadDelegate() {
         shared_ptr<LocRunnable> runnable = mRunnable.lock();
@@ -52,12 +155,26 @@ public:
             runnable->interrupt();
         }
     }
-    inline static LocThreadDelegate* create(const char* tName, shared_ptr<LocRunnable> runnable);
+    inline static LocThreadDelegate* create(const char* tName, shared_ptr<LocRunnable> runnable,
+                                            const LocThreadAttr& attr);
 };
 
 const char LocThreadDelegate::defaultThreadName[] = "LocThread";
 
-LocThreadDelegate* LocThreadDelegate::create(const char* tName, shared_ptr<LocRunnable> runnable) {
+void* LocThreadDelegate::threadMain(void* arg) {
+    ThreadArgs* args = (ThreadArgs*)arg;
+    prctl(PR_SET_NAME, args->mName.c_str(), 0, 0, 0);
+    args->mRunnable->prerun();
+    // after prerun() so that the configured attributes win
+    applyThreadAttr(args->mName.c_str(), args->mAttr);
+    while (args->mRunnable->run());
+    args->mRunnable->postrun();
+    delete args;
+    return nullptr;
+}
+
+LocThreadDelegate* LocThreadDelegate::create(const char* tName, shared_ptr<LocRunnable> runnable,
+                                             const LocThreadAttr& attr) {
     LocThreadDelegate* threadDelegate = nullptr;
 
     if (nullptr != runnable) {
@@ -71,30 +188,35 @@ LocThreadDelegate* LocThreadDelegate::create(const char* tName, shared_ptr<LocRu
         memcpy(lname, tName, len);
         lname[len] = 0;
 
-        threadDelegate = new LocThreadDelegate(lname, runnable);
+        pthread_attr_t pthreadAttr;
+        pthread_attr_init(&pthreadAttr);
+        pthread_attr_setdetachstate(&pthreadAttr, PTHREAD_CREATE_DETACHED);
+        if (0 != attr.mStackSize &&
+            0 != pthread_attr_setstacksize(&pthreadAttr, attr.mStackSize)) {
+            LOC_LOGe("%s: invalid stack size %zu, using default", lname, attr.mStackSize);
+        }
+
+        ThreadArgs* args = new ThreadArgs{lname, runnable, attr};
+        pthread_t thread;
+        // pthread_create() returns its error rather than setting errno
+        int err = pthread_create(&thread, &pthreadAttr, threadMain, args);
+        if (0 == err) {
+            threadDelegate = new LocThreadDelegate(runnable);
+        } else {
+            LOC_LOGe("%s: pthread_create failed - %s", lname, strerror(err));
+            delete args;
+        }
+        pthread_attr_destroy(&pthreadAttr);
     }
 
     return threadDelegate;
 }
 
-LocThreadDelegate::LocThreadDelegate(const string tName, shared_ptr<LocRunnable> runnable) :
-        mRunnable(runnable),
-        mThread([tName, runnable] {
-                prctl(PR_SET_NAME, tName.c_str(), 0, 0, 0);
-                runnable->prerun();
-                while (runnable->run());
-                runnable->postrun();
-            }) {
-
-    mThread.detach();
-}
-
-
-
-bool LocThread::start(const char* tName, shared_ptr<LocRunnable> runnable) {
+bool LocThread::start(const char* tName, shared_ptr<LocRunnable> runnable,
+                      const LocThreadAttr& attr) {
     bool success = false;
     if (!mThread) {
-        mThread = LocThreadDelegate::create(tName, runnable);
+        mThread = LocThreadDelegate::create(tName, runnable, attr);
         // true only if thread is created successfully
         success = (NULL != mThread);
     }
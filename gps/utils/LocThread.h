@@ -30,6 +30,7 @@
 #define __LOC_THREAD__
 
 #include <stddef.h>
+#include <stdint.h>
 #include <memory>
 
 using std::shared_ptr;
@@ -62,6 +63,39 @@ public:
     inline virtual void interrupt() = 0;
 };
 
+// Scheduling attributes of a LocThread. The defaults leave everything as
+// inherited from the creating thread.
+struct LocThreadAttr {
+    uint32_t mCpuMask;      // CPUs to run on, bit n for CPU n; 0 for any
+    int mPolicy;            // SCHED_OTHER or SCHED_FIFO; -1 to leave as is
+    int mPriority;          // SCHED_FIFO priority, or nice value with SCHED_OTHER
+    size_t mStackSize;      // bytes, 0 for the default
+    uint64_t mTimerSlackNs; // 0 to leave as is
+    inline LocThreadAttr() :
+        mCpuMask(0), mPolicy(-1), mPriority(0), mStackSize(0), mTimerSlackNs(0) {}
+
+    // Reads the attributes of a thread role from gps.conf, i.e.
+    // <role>_THREAD_CPU_MASK, <role>_THREAD_SCHED_POLICY (0 for SCHED_OTHER,
+    // 1 for SCHED_FIFO), <role>_THREAD_PRIORITY, <role>_THREAD_STACK_KB and
+    // <role>_THREAD_TIMER_SLACK_US.
+    static LocThreadAttr fromConf(const char* role);
+};
+
+// Tracks how late a thread wakes up compared to when it was due, and logs
+// the average and max every kLogInterval wakeups. Not thread safe, meant to
+// be fed by the thread itself.
+class LocWakeupJitter {
+    static const uint32_t kLogInterval = 256;
+    const char* mName;
+    uint32_t mCount;
+    uint64_t mTotalNs;
+    uint64_t mMaxNs;
+public:
+    inline LocWakeupJitter(const char* name) :
+        mName(name), mCount(0), mTotalNs(0), mMaxNs(0) {}
+    void add(int64_t lateNs);
+};
+
 // opaque class to provide service implementation.
 class LocThreadDelegate;
 
@@ -82,8 +116,10 @@ public:
     //          The obj will be deleted by LocThread if start()
     //          returns true. Else it is client's responsibility
     //          to delete the object
+    // attr is applied in the new thread after runnable->prerun().
     // Returns 0 if success; false if failure.
-    bool start(const char* threadName, shared_ptr<LocRunnable> runnable);
+    bool start(const char* threadName, shared_ptr<LocRunnable> runnable,
+               const LocThreadAttr& attr = LocThreadAttr());
 
     void stop();
 
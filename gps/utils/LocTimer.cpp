@@ -34,13 +34,17 @@
 #include <errno.h>
 #include <sys/timerfd.h>
 #include <sys/epoll.h>
+#include <inttypes.h>
+#include <atomic>
 #include <log_util.h>
 #include <loc_timer.h>
 #include <LocTimer.h>
 #include <LocHeap.h>
+#include <LocTimingWheel.h>
 #include <LocThread.h>
 #include <LocSharedLock.h>
 #include <MsgTask.h>
+#include <loc_cfg.h>
 
 #ifdef __HOST_UNIT_TEST__
 #define EPOLLWAKEUP 0
@@ -68,6 +72,8 @@ LocTimerDelegate - an internal timer entity, which also is a LocRankable obj.
                    in the heap.
 LocTimerContainer - core of the timer service. It is a container (derived from
                     LocHeap) for LocTimerDelegate (implements LocRankable) objs.
+                    With TIMER_CONTAINER=1 in gps.conf the objs are kept on a
+                    LocTimingWheel instead, with O(1) add / remove.
                     There are 2 of such containers, one for sw timers (or Linux
                     timers) one for hw timers (or Linux alarms). It adds one of
                     each (those that expire the soonest) to kernel via services
@@ -85,6 +91,27 @@ LocTimerWrapper - a LocTimer client itself, to implement the existing C API with
 
 class LocTimerPollTask;
 
+// Timer slack: a timer started with slack is ranked, and armed, by its
+// latest acceptable time, mFutureTime, yet expires as soon as its earliest
+// time, mSoftTime, has passed. When the timerfd fires, timers are popped in
+// order for as long as their soft time has passed, so timers whose windows
+// overlap expire together in one wakeup and one container pass.
+// syscalls saved: timers that did not re-arm the timerfd only thanks to
+//                 their slack
+// wakeups merged: timers that expired before their latest time, i.e. rode
+//                 along on the wakeup of another timer
+static std::atomic<uint64_t> sSyscallsSaved(0);
+static std::atomic<uint64_t> sWakeupsMerged(0);
+
+// client of the periodic timer whose callback the timer thread is running,
+// NULL once it stopped its own timer; see LocTimer::stop()
+static thread_local LocTimer* sCallbackClient = NULL;
+
+static inline bool isNotAfter(const struct timespec& time, const struct timespec& ref) {
+    return (time.tv_sec < ref.tv_sec) ||
+           (time.tv_sec == ref.tv_sec && time.tv_nsec <= ref.tv_nsec);
+}
+
 // This is a multi-functaional class that:
 // * extends the LocHeap class for the detection of head update upon add / remove
 //   events. When that happens, soonest time out changes, so timerfd needs update.
@@ -106,8 +133,10 @@ class LocTimerContainer : public LocHeap {
     static LocTimerPollTask* mPollTask;
     // timer / alarm fd
     int mDevFd;
+    // timing wheel used instead of the heap, NULL if not configured
+    LocTimingWheel* mWheel;
     // ctor
-    LocTimerContainer(bool wakeOnExpire);
+    LocTimerContainer(bool wakeOnExpire, bool useWheel);
     // dtor
     ~LocTimerContainer();
     static MsgTask* getMsgTaskLocked();
@@ -116,6 +145,10 @@ class LocTimerContainer : public LocHeap {
     LocTimerDelegate* popIfOutRanks(LocTimerDelegate& timer);
     // update the timer POSIX calls with updated soonest timer spec
     void updateSoonestTime(LocTimerDelegate* priorTop);
+    // heap or wheel, whichever this container uses
+    void pushTimer(LocTimerDelegate& timer);
+    LocTimerDelegate* popTimer();
+    LocTimerDelegate* removeTimer(LocTimerDelegate& timer);
 
 public:
     // factory method to control the creation of mSwTimers / mHwTimers
@@ -185,24 +218,36 @@ public:
 // and gets deleted when client calls LocTimer::stop() or when the it expire()'s.
 // This class implements LocRankable::ranks() so that when an obj is added into
 // the container (of LocHeap), it gets placed in sorted order.
-class LocTimerDelegate : public LocRankable {
+class LocTimerDelegate : public LocRankable, public LocWheelNode {
     friend class LocTimerContainer;
     friend class LocTimer;
     LocTimer* mClient;
     LocSharedLock* mLock;
+    // latest time to expire, ranks the timer
     struct timespec mFutureTime;
+    // earliest time to expire, same as mFutureTime without slack
+    struct timespec mSoftTime;
     LocTimerContainer* mContainer;
+    // period of a periodic timer, 0 for one shot
+    const uint32_t mPeriodInMs;
     // not a complete obj, just ctor for LocRankable comparisons
     inline LocTimerDelegate(struct timespec& delay)
-        : mClient(NULL), mLock(NULL), mFutureTime(delay), mContainer(NULL) {}
+        : mClient(NULL), mLock(NULL), mFutureTime(delay), mSoftTime(delay), mContainer(NULL),
+          mPeriodInMs(0) {}
     inline ~LocTimerDelegate() { if (mLock) { mLock->drop(); mLock = NULL; } }
 public:
-    LocTimerDelegate(LocTimer& client, struct timespec& futureTime, LocTimerContainer* container);
+    LocTimerDelegate(LocTimer& client, struct timespec& softTime,
+                     struct timespec& futureTime, LocTimerContainer* container,
+                     uint32_t periodInMs = 0);
     void destroyLocked();
     // LocRankable virtual method
     virtual int ranks(LocRankable& rankable);
     void expire();
+    inline bool isPeriodic() { return 0 != mPeriodInMs; }
+    LocTimer* advancePeriod(const struct timespec& now);
+    void endCallback(LocTimer* client);
     inline struct timespec getFutureTime() { return mFutureTime; }
+    inline struct timespec getSoftTime() { return mSoftTime; }
 };
 
 /***************************LocTimerContainer methods***************************/
@@ -218,11 +263,18 @@ LocTimerContainer* LocTimerContainer::mHwTimers = NULL;
 MsgTask* LocTimerContainer::mMsgTask = NULL;
 LocTimerPollTask* LocTimerContainer::mPollTask = NULL;
 
+// wheel ticks are ms of CLOCK_BOOTTIME. Due ticks round up and the tick of
+// now rounds down, so that a timer never expires early.
+static inline uint64_t getWheelTick(const struct timespec& time, bool roundUp) {
+    return (uint64_t)time.tv_sec * 1000 + (time.tv_nsec + (roundUp ? 999999 : 0)) / 1000000;
+}
+
 // ctor - initialize timer heaps
 // A container for swTimer (timer) is created, when wakeOnExpire is true; or
 // HwTimer (alarm), when wakeOnExpire is false.
-LocTimerContainer::LocTimerContainer(bool wakeOnExpire) :
-    mDevFd(timerfd_create(wakeOnExpire ? CLOCK_BOOTTIME_ALARM : CLOCK_BOOTTIME, 0)) {
+LocTimerContainer::LocTimerContainer(bool wakeOnExpire, bool useWheel) :
+    mDevFd(timerfd_create(wakeOnExpire ? CLOCK_BOOTTIME_ALARM : CLOCK_BOOTTIME, 0)),
+    mWheel(NULL) {
 
     if ((-1 == mDevFd) && (errno == EINVAL)) {
         LOC_LOGW("%s: timerfd_create failure, fallback to CLOCK_MONOTONIC - %s",
@@ -237,6 +289,12 @@ LocTimerContainer::LocTimerContainer(bool wakeOnExpire) :
     } else {
         LOC_LOGE("%s: timerfd_create failure - %s", __FUNCTION__, strerror(errno));
     }
+
+    if (useWheel) {
+        struct timespec now;
+        clock_gettime(CLOCK_BOOTTIME, &now);
+        mWheel = new LocTimingWheel(getWheelTick(now, false));
+    }
 }
 
 // dtor
@@ -244,6 +302,7 @@ LocTimerContainer::LocTimerContainer(bool wakeOnExpire) :
 inline
 LocTimerContainer::~LocTimerContainer() {
     close(mDevFd);
+    delete mWheel;
 }
 
 LocTimerContainer* LocTimerContainer::get(bool wakeOnExpire) {
@@ -254,7 +313,18 @@ LocTimerContainer* LocTimerContainer::get(bool wakeOnExpire) {
         pthread_mutex_lock(&mMutex);
         // let's check one more time to be safe
         if (!container) {
-            container = new LocTimerContainer(wakeOnExpire);
+            // 0: heap (default), 1: timing wheel
+            static uint32_t sContainerType = 0;
+            static bool sConfRead = false;
+            if (!sConfRead) {
+                const loc_param_s_type timer_conf_param_table[] =
+                {
+                    {"TIMER_CONTAINER", &sContainerType, NULL, 'n'},
+                };
+                UTIL_READ_CONF(LOC_PATH_GPS_CONF, timer_conf_param_table);
+                sConfRead = true;
+            }
+            container = new LocTimerContainer(wakeOnExpire, (1 == sContainerType));
             // timerfd_create failure
             if (-1 == container->getTimerFd()) {
                 delete container;
@@ -284,9 +354,37 @@ LocTimerPollTask* LocTimerContainer::getPollTaskLocked() {
 
 inline
 LocTimerDelegate* LocTimerContainer::getSoonestTimer() {
+    if (mWheel) {
+        return static_cast<LocTimerDelegate*>(mWheel->peek());
+    }
     return (LocTimerDelegate*)(peek());
 }
 
+inline
+void LocTimerContainer::pushTimer(LocTimerDelegate& timer) {
+    if (mWheel) {
+        mWheel->add(timer, getWheelTick(timer.mFutureTime, true));
+    } else {
+        push((LocRankable&)timer);
+    }
+}
+
+inline
+LocTimerDelegate* LocTimerContainer::popTimer() {
+    if (mWheel) {
+        return static_cast<LocTimerDelegate*>(mWheel->pop());
+    }
+    return (LocTimerDelegate*)(pop());
+}
+
+inline
+LocTimerDelegate* LocTimerContainer::removeTimer(LocTimerDelegate& timer) {
+    if (mWheel) {
+        return static_cast<LocTimerDelegate*>(mWheel->remove(timer));
+    }
+    return (LocTimerDelegate*)(((LocHeap*)this)->remove((LocRankable&)timer));
+}
+
 inline
 int LocTimerContainer::getTimerFd() {
     return mDevFd;
@@ -312,6 +410,12 @@ void LocTimerContainer::updateSoonestTime(LocTimerDelegate* priorTop) {
             // with too small an interval
             mPollTask->addPoll(*this);
             delay.it_value = curTop->getFutureTime();
+            if (mWheel) {
+                // the tick the wheel expires it at
+                uint64_t tick = curTop->getTick();
+                delay.it_value.tv_sec = tick / 1000;
+                delay.it_value.tv_nsec = (tick % 1000) * 1000000;
+            }
             toSetTime = true;
         }
         if (toSetTime) {
@@ -330,7 +434,12 @@ void LocTimerContainer::add(LocTimerDelegate& timer) {
             LocMsg(), mTimerContainer(&container), mTimer(&timer) {}
         inline virtual void proc() const {
             LocTimerDelegate* priorTop = mTimerContainer->getSoonestTimer();
-            mTimerContainer->push((LocRankable&)(*mTimer));
+            // it would have been the new top without slack
+            if (priorTop && !isNotAfter(priorTop->mFutureTime, mTimer->mSoftTime) &&
+                isNotAfter(priorTop->mFutureTime, mTimer->mFutureTime)) {
+                sSyscallsSaved.fetch_add(1, std::memory_order_relaxed);
+            }
+            mTimerContainer->pushTimer(*mTimer);
             mTimerContainer->updateSoonestTime(priorTop);
         }
     };
@@ -350,7 +459,7 @@ void LocTimerContainer::remove(LocTimerDelegate& timer) {
 
             // update soonest timer only if mTimer is actually removed from
             // mTimerContainer AND mTimer is not priorTop.
-            if (priorTop == ((LocHeap*)mTimerContainer)->remove((LocRankable&)*mTimer)) {
+            if (priorTop == mTimerContainer->removeTimer(*mTimer)) {
                 // if passing in NULL, we tell updateSoonestTime to update
                 // kernel with the current top timer interval.
                 mTimerContainer->updateSoonestTime(NULL);
@@ -376,11 +485,33 @@ void LocTimerContainer::expire() {
             // get time spec of now
             clock_gettime(CLOCK_BOOTTIME, &now);
             LocTimerDelegate timerOfNow(now);
-            // pop everything in the heap that outRanks now, i.e. has time older than now
+            // pop everything in the heap whose soft time is older than now
             // and then call expire() on that timer.
-            for (LocTimerDelegate* timer = (LocTimerDelegate*)mTimerContainer->pop();
+            // only ever fed from the timer MsgTask thread
+            static LocWakeupJitter sJitter("LocTimer");
+            for (LocTimerDelegate* timer = mTimerContainer->popTimer();
                  NULL != timer;
                  timer = mTimerContainer->popIfOutRanks(timerOfNow)) {
+                struct timespec due = timer->getSoftTime();
+                sJitter.add((int64_t)(now.tv_sec - due.tv_sec) * 1000000000LL +
+                            (now.tv_nsec - due.tv_nsec));
+                if (!isNotAfter(timer->mFutureTime, now)) {
+                    sWakeupsMerged.fetch_add(1, std::memory_order_relaxed);
+                }
+                if (timer->isPeriodic()) {
+                    // same delegate back in, for the next period; it is due
+                    // after now, so this loop does not pop it again
+                    LocTimer* client = timer->advancePeriod(now);
+                    if (client) {
+                        mTimerContainer->pushTimer(*timer);
+                        sCallbackClient = client;
+                        client->timeOutCallback();
+                        // the remove msg of a stop() meanwhile is queued
+                        // behind this one, so timer is still around
+                        timer->endCallback(client);
+                    }
+                    continue;
+                }
                 // the timer delegate obj will be deleted before the return of this call
                 timer->expire();
             }
@@ -395,10 +526,18 @@ void LocTimerContainer::expire() {
     mMsgTask->sendMsg(new MsgTimerExpire(*this));
 }
 
+// pops the top if its soft time is not later than that of the input
 LocTimerDelegate* LocTimerContainer::popIfOutRanks(LocTimerDelegate& timer) {
     LocTimerDelegate* poppedNode = NULL;
-    if (mTree && !timer.outRanks(*peek())) {
-        poppedNode = (LocTimerDelegate*)(pop());
+    if (mWheel) {
+        poppedNode = static_cast<LocTimerDelegate*>(
+                mWheel->popDue(getWheelTick(timer.mFutureTime, false)));
+    }
+    if (NULL == poppedNode) {
+        LocTimerDelegate* top = getSoonestTimer();
+        if (top && isNotAfter(top->mSoftTime, timer.mSoftTime)) {
+            poppedNode = popTimer();
+        }
     }
 
     return poppedNode;
@@ -414,7 +553,8 @@ LocTimerPollTask::LocTimerPollTask()
     // could already be running in parallel. Also, since each of the objs
     // creates a thread, the container will make sure that there will be only
     // one of such obj for our timer implementation.
-    mThread.start("LocTimerPollTask", std::make_shared<TimerRunnable>(mFd));
+    mThread.start("LocTimerPollTask", std::make_shared<TimerRunnable>(mFd),
+                  LocThreadAttr::fromConf("TIMER"));
 }
 
 void LocTimerPollTask::addPoll(LocTimerContainer& timerContainer) {
@@ -468,12 +608,16 @@ bool TimerRunnable::run() {
 
 inline
 LocTimerDelegate::LocTimerDelegate(LocTimer& client,
+                                   struct timespec& softTime,
                                    struct timespec& futureTime,
-                                   LocTimerContainer* container)
+                                   LocTimerContainer* container,
+                                   uint32_t periodInMs)
     : mClient(&client),
       mLock(mClient->mLock->share()),
       mFutureTime(futureTime),
-      mContainer(container) {
+      mSoftTime(softTime),
+      mContainer(container),
+      mPeriodInMs(periodInMs) {
     // adding the timer into the container
     mContainer->add(*this);
 }
@@ -529,8 +673,47 @@ void LocTimerDelegate::expire() {
 }
 
 
+// Moves the deadline of a periodic timer on by whole periods from the last
+// deadline, not from now, so it never drifts. Periods missed altogether, e.g.
+// over suspend with a non wakeup timer, are skipped.
+// returns the client to call back, marked as in the callback until
+//         endCallback(); NULL if the timer has been stopped, in which case
+//         the delegate is about to be deleted by the remove msg.
+LocTimer* LocTimerDelegate::advancePeriod(const struct timespec& now) {
+    LocTimer* client = NULL;
+    mLock->lock();
+    if (mClient && mContainer) {
+        const int64_t periodNs = (int64_t)mPeriodInMs * 1000000;
+        int64_t lateNs = (int64_t)(now.tv_sec - mSoftTime.tv_sec) * 1000000000LL +
+                         (now.tv_nsec - mSoftTime.tv_nsec);
+        int64_t stepNs = (lateNs / periodNs + 1) * periodNs;
+        mSoftTime.tv_sec += stepNs / 1000000000LL;
+        mSoftTime.tv_nsec += stepNs % 1000000000LL;
+        if (mSoftTime.tv_nsec >= 1000000000) {
+            mSoftTime.tv_sec++;
+            mSoftTime.tv_nsec -= 1000000000;
+        }
+        mFutureTime = mSoftTime;
+        client = mClient;
+        client->mInCallback = true;
+    }
+    mLock->unlock();
+    return client;
+}
+
+// lets a stop() waiting on the callback of client return; client is left
+// alone if it stopped its timer from the callback, as it may be gone by now.
+void LocTimerDelegate::endCallback(LocTimer* client) {
+    mLock->lock();
+    if (sCallbackClient == client) {
+        client->mInCallback = false;
+    }
+    sCallbackClient = NULL;
+    mLock->unlock();
+}
+
 /***************************LocTimer methods***************************/
-LocTimer::LocTimer() : mTimer(NULL), mLock(new LocSharedLock()) {
+LocTimer::LocTimer() : mTimer(NULL), mLock(new LocSharedLock()), mInCallback(false) {
 }
 
 LocTimer::~LocTimer() {
@@ -541,23 +724,29 @@ LocTimer::~LocTimer() {
     }
 }
 
-bool LocTimer::start(unsigned int timeOutInMs, bool wakeOnExpire) {
+static inline void addMs(struct timespec& time, uint32_t ms) {
+    time.tv_sec += ms / 1000;
+    time.tv_nsec += (ms % 1000) * 1000000;
+    if (time.tv_nsec >= 1000000000) {
+        time.tv_sec += time.tv_nsec / 1000000000;
+        time.tv_nsec %= 1000000000;
+    }
+}
+
+bool LocTimer::start(unsigned int timeOutInMs, bool wakeOnExpire, uint32_t slackInMs) {
     bool success = false;
     mLock->lock();
     if (!mTimer) {
-        struct timespec futureTime;
-        clock_gettime(CLOCK_BOOTTIME, &futureTime);
-        futureTime.tv_sec += timeOutInMs / 1000;
-        futureTime.tv_nsec += (timeOutInMs % 1000) * 1000000;
-        if (futureTime.tv_nsec >= 1000000000) {
-            futureTime.tv_sec += futureTime.tv_nsec / 1000000000;
-            futureTime.tv_nsec %= 1000000000;
-        }
+        struct timespec softTime;
+        clock_gettime(CLOCK_BOOTTIME, &softTime);
+        addMs(softTime, timeOutInMs);
+        struct timespec futureTime = softTime;
+        addMs(futureTime, slackInMs);
 
         LocTimerContainer* container;
         container = LocTimerContainer::get(wakeOnExpire);
         if (NULL != container) {
-            mTimer = new LocTimerDelegate(*this, futureTime, container);
+            mTimer = new LocTimerDelegate(*this, softTime, futureTime, container);
             // if mTimer is non 0, success should be 0; or vice versa
         }
         success = (NULL != mTimer);
@@ -566,6 +755,25 @@ bool LocTimer::start(unsigned int timeOutInMs, bool wakeOnExpire) {
     return success;
 }
 
+bool LocTimer::startPeriodic(uint32_t intervalInMs, bool wakeOnExpire) {
+    bool success = false;
+    mLock->lock();
+    if (!mTimer && intervalInMs > 0) {
+        struct timespec futureTime;
+        clock_gettime(CLOCK_BOOTTIME, &futureTime);
+        addMs(futureTime, intervalInMs);
+
+        LocTimerContainer* container = LocTimerContainer::get(wakeOnExpire);
+        if (NULL != container) {
+            mTimer = new LocTimerDelegate(*this, futureTime, futureTime, container,
+                                          intervalInMs);
+        }
+        success = (NULL != mTimer);
+    }
+    mLock->unlock();
+    return success;
+}
+
 bool LocTimer::stop() {
     bool success = false;
     mLock->lock();
@@ -577,10 +785,27 @@ bool LocTimer::stop() {
             success = true;
         }
     }
+    if (sCallbackClient == this) {
+        // called from the callback itself, which is then done with the client
+        mInCallback = false;
+        sCallbackClient = NULL;
+    } else {
+        // the client may be deleted once this returns
+        while (mInCallback) {
+            mLock->unlock();
+            usleep(1000);
+            mLock->lock();
+        }
+    }
     mLock->unlock();
     return success;
 }
 
+void LocTimer::getCoalescingStats(uint64_t& syscallsSaved, uint64_t& wakeupsMerged) {
+    syscallsSaved = sSyscallsSaved.load(std::memory_order_relaxed);
+    wakeupsMerged = sWakeupsMerged.load(std::memory_order_relaxed);
+}
+
 /***************************LocTimerWrapper methods***************************/
 //////////////////////////////////////////////////////////////////////////
 // This section below wraps for the C style APIs
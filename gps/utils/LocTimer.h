@@ -45,6 +45,9 @@ class LocTimer
 {
     LocTimerDelegate* mTimer;
     LocSharedLock* mLock;
+    // true while the timer thread runs the callback of a periodic timer,
+    // guarded by mLock; stop() waits for it to clear
+    bool mInCallback;
     // don't really want mLock to be manipulated by clients, yet LocTimer
     // has to have a reference to the lock so that the delete of LocTimer
     // and LocTimerDelegate can work together on their share resources.
@@ -59,10 +62,24 @@ public:
     //                        expiration and notify the client.
     //               false if to wait until next time CPU wakes up (if
     //                        sleeping) and then notify the client.
+    // slackInMs:    how much later than timeOutInMs the timer may expire,
+    //               so that it can expire along with other timers in one
+    //               wakeup instead of waking up on its own.
     // return:       true on success;
     //               false on failure, e.g. timer is already running.
-    bool start(uint32_t timeOutInMs, bool wakeOnExpire);
+    bool start(uint32_t timeOutInMs, bool wakeOnExpire, uint32_t slackInMs = 0);
 
+    // Starts a timer that calls timeOutCallback() every intervalInMs until
+    // stop() is called. Expiries are scheduled on whole intervals from the
+    // start, so they do not drift, and no allocation is made per interval.
+    // return:       true on success;
+    //               false on failure, e.g. timer is already running.
+    bool startPeriodic(uint32_t intervalInMs, bool wakeOnExpire);
+
+    // For a periodic timer, once stop() returns, timeOutCallback() is neither
+    // running nor called again, so the client may be deleted; the client must
+    // therefore not hold a lock its timeOutCallback() takes when stopping it.
+    // A one shot timer's timeOutCallback() may still be running.
     // return:       true on success;
     //               false on failure, e.g. timer is not running.
     bool stop();
@@ -71,6 +88,10 @@ public:
     //  This method is used for timeout calling back to client. This method
     //  should be short enough (eg: send a message to your own thread).
     virtual void timeOutCallback() = 0;
+
+    // process wide counts of timerfd re-arms avoided, and of timers that
+    // expired early on the wakeup of another timer, thanks to slack
+    static void getCoalescingStats(uint64_t& syscallsSaved, uint64_t& wakeupsMerged);
 };
 
 } // namespace loc_util
@@ -0,0 +1,226 @@
+/* Copyright (c) 2020 The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <string.h>
+#include <LocTimingWheel.h>
+
+namespace loc_util {
+
+LocTimingWheel::LocTimingWheel(uint64_t nowTick) :
+    mNow(nowTick), mOverflow(NULL), mExpired(NULL), mExpiredTail(NULL), mSoonest(NULL) {
+    memset(mPending, 0, sizeof(mPending));
+    memset(mSlots, 0, sizeof(mSlots));
+}
+
+// slot lists are LIFO, only the expired list keeps a tail to stay in order
+void LocTimingWheel::link(LocWheelNode& node, LocWheelNode*& list) {
+    node.mList = &list;
+    if (&list == &mExpired) {
+        node.mPrev = mExpiredTail;
+        node.mNext = NULL;
+        if (mExpiredTail) {
+            mExpiredTail->mNext = &node;
+        } else {
+            mExpired = &node;
+        }
+        mExpiredTail = &node;
+    } else {
+        node.mPrev = NULL;
+        node.mNext = list;
+        if (list) {
+            list->mPrev = &node;
+        }
+        list = &node;
+    }
+}
+
+void LocTimingWheel::unlink(LocWheelNode& node) {
+    LocWheelNode** list = node.mList;
+    if (node.mPrev) {
+        node.mPrev->mNext = node.mNext;
+    } else {
+        *list = node.mNext;
+    }
+    if (node.mNext) {
+        node.mNext->mPrev = node.mPrev;
+    } else if (list == &mExpired) {
+        mExpiredTail = node.mPrev;
+    }
+
+    // clear the pending bit of a wheel slot that just went empty
+    if (NULL == *list && list >= &mSlots[0][0] && list < &mSlots[0][0] + kLevels * kSlots) {
+        size_t index = list - &mSlots[0][0];
+        mPending[index / kSlots] &= ~(1ULL << (index % kSlots));
+    }
+
+    node.mPrev = NULL;
+    node.mNext = NULL;
+    node.mList = NULL;
+}
+
+// links node into the slot its tick maps to relative to mNow
+void LocTimingWheel::place(LocWheelNode& node) {
+    if (node.mTick <= mNow) {
+        link(node, mExpired);
+    } else {
+        uint32_t level = (63 - __builtin_clzll(node.mTick ^ mNow)) / kBits;
+        if (level >= kLevels) {
+            link(node, mOverflow);
+        } else {
+            uint32_t digit = (node.mTick >> (level * kBits)) & (kSlots - 1);
+            link(node, mSlots[level][digit]);
+            mPending[level] |= (1ULL << digit);
+        }
+    }
+}
+
+// Moves mNow on to tick. The slots mNow passes, at every level, hold nodes
+// that are now either due or a lower level away, so they are all placed
+// again, lower levels first to keep the expired list in order.
+void LocTimingWheel::advance(uint64_t tick) {
+    LocWheelNode* moved = NULL;
+    LocWheelNode* movedTail = NULL;
+
+    for (uint32_t level = 0; level < kLevels; level++) {
+        if (0 == mPending[level]) {
+            continue;
+        }
+        uint32_t shift = level * kBits;
+        uint64_t mask = ~0ULL;
+        // mNow still in the same block of this level, only the slots it
+        // passed in there; else the whole level
+        if ((mNow >> (shift + kBits)) == (tick >> (shift + kBits))) {
+            uint32_t from = (mNow >> shift) & (kSlots - 1);
+            uint32_t to = (tick >> shift) & (kSlots - 1);
+            mask = ((2ULL << to) - 1) & ~((2ULL << from) - 1);
+        }
+        for (uint64_t bits = mPending[level] & mask; 0 != bits; bits &= bits - 1) {
+            uint32_t digit = __builtin_ctzll(bits);
+            LocWheelNode* list = mSlots[level][digit];
+            mSlots[level][digit] = NULL;
+            if (movedTail) {
+                movedTail->mNext = list;
+            } else {
+                moved = list;
+            }
+            for (movedTail = list; NULL != movedTail->mNext; movedTail = movedTail->mNext);
+        }
+        mPending[level] &= ~mask;
+    }
+
+    if (mOverflow && (mNow >> (kLevels * kBits)) != (tick >> (kLevels * kBits))) {
+        LocWheelNode* list = mOverflow;
+        mOverflow = NULL;
+        if (movedTail) {
+            movedTail->mNext = list;
+        } else {
+            moved = list;
+        }
+    }
+
+    mNow = tick;
+    mSoonest = NULL;
+
+    while (moved) {
+        LocWheelNode* node = moved;
+        moved = node->mNext;
+        place(*node);
+    }
+}
+
+// nodes of a slot above level 0 are due at different ticks
+LocWheelNode* LocTimingWheel::findSoonest(LocWheelNode* list) {
+    LocWheelNode* soonest = list;
+    for (LocWheelNode* node = list; NULL != node; node = node->mNext) {
+        if (node->mTick < soonest->mTick) {
+            soonest = node;
+        }
+    }
+    return soonest;
+}
+
+void LocTimingWheel::add(LocWheelNode& node, uint64_t tick) {
+    if (node.mList) {
+        return;
+    }
+    node.mTick = tick;
+    place(node);
+    if (mSoonest && tick < mSoonest->mTick) {
+        mSoonest = &node;
+    }
+}
+
+LocWheelNode* LocTimingWheel::remove(LocWheelNode& node) {
+    if (NULL == node.mList) {
+        return NULL;
+    }
+    if (&node == mSoonest) {
+        mSoonest = NULL;
+    }
+    unlink(node);
+    return &node;
+}
+
+LocWheelNode* LocTimingWheel::peek() {
+    if (mExpired) {
+        return mExpired;
+    }
+    if (NULL == mSoonest) {
+        for (uint32_t level = 0; level < kLevels && NULL == mSoonest; level++) {
+            if (0 != mPending[level]) {
+                LocWheelNode* list = mSlots[level][__builtin_ctzll(mPending[level])];
+                mSoonest = (0 == level) ? list : findSoonest(list);
+            }
+        }
+        if (NULL == mSoonest && mOverflow) {
+            mSoonest = findSoonest(mOverflow);
+        }
+    }
+    return mSoonest;
+}
+
+LocWheelNode* LocTimingWheel::pop() {
+    LocWheelNode* node = peek();
+    if (node) {
+        remove(*node);
+    }
+    return node;
+}
+
+LocWheelNode* LocTimingWheel::popDue(uint64_t nowTick) {
+    if (nowTick > mNow) {
+        advance(nowTick);
+    }
+    LocWheelNode* node = mExpired;
+    if (node) {
+        remove(*node);
+    }
+    return node;
+}
+
+} // namespace loc_util
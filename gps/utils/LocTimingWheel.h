@@ -0,0 +1,112 @@
+/* Copyright (c) 2020 The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef __LOC_TIMING_WHEEL__
+#define __LOC_TIMING_WHEEL__
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace loc_util {
+
+// base class of objs to be queued on a LocTimingWheel. The links live in the
+// obj itself, so the wheel never allocates.
+class LocWheelNode {
+    friend class LocTimingWheel;
+    uint64_t mTick;
+    LocWheelNode* mPrev;
+    LocWheelNode* mNext;
+    // head of the list this node is on, NULL if not queued
+    LocWheelNode** mList;
+public:
+    inline LocWheelNode() : mTick(0), mPrev(NULL), mNext(NULL), mList(NULL) {}
+    virtual inline ~LocWheelNode() {}
+    inline uint64_t getTick() const { return mTick; }
+    inline bool isQueued() const { return NULL != mList; }
+};
+
+// A hierarchical timing wheel of kLevels levels of 64 slots each. A node due
+// at tick t sits at the level of the highest 6 bit digit in which t differs
+// from the wheel's current tick, in the slot of that digit of t. Hence all
+// the nodes of a level are due before any node of the levels above, and
+// add() / remove() are O(1). As the current tick moves on, the slots it
+// passes are cascaded down, so each node is moved at most kLevels times.
+// The unit of a tick is up to the client, it is never related to a clock
+// by the wheel.
+class LocTimingWheel {
+    static const uint32_t kBits = 6;
+    static const uint32_t kSlots = 1 << kBits;
+    static const uint32_t kLevels = 6;
+
+    uint64_t mNow;
+    // bit n set if mSlots[level][n] is not empty
+    uint64_t mPending[kLevels];
+    LocWheelNode* mSlots[kLevels][kSlots];
+    // nodes due too far out for the top level
+    LocWheelNode* mOverflow;
+    // nodes already due, in the order they were found due
+    LocWheelNode* mExpired;
+    LocWheelNode* mExpiredTail;
+    // cached result of peek(), NULL if to be looked up
+    LocWheelNode* mSoonest;
+
+    void link(LocWheelNode& node, LocWheelNode*& list);
+    void unlink(LocWheelNode& node);
+    void place(LocWheelNode& node);
+    void advance(uint64_t tick);
+    static LocWheelNode* findSoonest(LocWheelNode* list);
+public:
+    LocTimingWheel(uint64_t nowTick);
+    inline ~LocTimingWheel() {}
+
+    // queues node to be due at tick. A tick not later than the current one
+    // makes the node due right away. node must not be queued already.
+    void add(LocWheelNode& node, uint64_t tick);
+
+    // dequeues node, no op if it is not queued.
+    // returns &node if it was queued; NULL otherwise.
+    LocWheelNode* remove(LocWheelNode& node);
+
+    // the node that is due the soonest, NULL if the wheel is empty. Nodes due
+    // at the same tick, or at or before the current tick, are returned in no
+    // particular order.
+    LocWheelNode* peek();
+
+    // dequeues and returns peek()
+    LocWheelNode* pop();
+
+    // moves the current tick on to nowTick, if it is later, then dequeues and
+    // returns a node due at or before it; NULL if there is none.
+    LocWheelNode* popDue(uint64_t nowTick);
+
+    inline uint64_t getNow() const { return mNow; }
+};
+
+} // namespace loc_util
+
+#endif //__LOC_TIMING_WHEEL__
@@ -28,6 +28,15 @@
  */
 
 #include "LogBuffer.h"
+#include <algorithm>
+#include <string.h>
+#include <ctype.h>
+#include <stddef.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #ifdef USE_GLIB
 #include <execinfo.h>
 #endif
@@ -44,6 +53,120 @@ struct sigaction LogBuffer::mOriSigAction[NSIG];
 struct sigaction LogBuffer::mNewSigAction;
 mutex LogBuffer::sLock;
 
+// hands the rings of the calling thread over to the next new thread once
+// the calling thread exits
+struct LogBufferThreadHolder {
+    LogBufferThread* mThread = nullptr;
+    inline ~LogBufferThreadHolder() {
+        if (nullptr != mThread) {
+            mThread->mInUse.store(false, memory_order_release);
+        }
+    }
+};
+static thread_local LogBufferThreadHolder sThreadHolder;
+
+static const char* const sLevelNames[TOTAL_LOG_LEVELS] = {"E", "W", "I", "D", "V"};
+
+// CLOCK_REALTIME - CLOCK_BOOTTIME, in ns
+static uint64_t getBootToRealtime() {
+    timespec boot, real;
+    clock_gettime(CLOCK_BOOTTIME, &boot);
+    clock_gettime(CLOCK_REALTIME, &real);
+    return (real.tv_sec - boot.tv_sec) * 1000000000ULL + (real.tv_nsec - boot.tv_nsec);
+}
+
+// Copies str and its '\0' to out, cut to fit before end; returns the end of the copy
+static char* packString(char* out, const char* end, const char* str) {
+    if (out < end) {
+        size_t len = strnlen(str, end - out - 1);
+        memcpy(out, str, len);
+        out[len] = 0;
+        out += len + 1;
+    }
+    return out;
+}
+
+LogBufferRing::LogBufferRing(uint32_t capacity, int level, bool shared, void* memory) :
+        mCapacity(std::max(capacity, 1U)),
+        mMemory((nullptr == memory) ? new char[memorySize(mCapacity)] : nullptr),
+        mHeader(new ((nullptr == memory) ? mMemory.get() : memory) LogBufferRingHeader()),
+        mSlots((LogBufferSlot*)(mHeader + 1)), mInFile(nullptr != memory),
+        mAppendLock(shared ? new mutex() : nullptr) {
+    for (uint32_t i = 0; i < mCapacity; i++) {
+        new (&mSlots[i]) LogBufferSlot;
+        mSlots[i].mSeq.store(0, memory_order_relaxed);
+    }
+    mHeader->mLevel = level;
+    mHeader->mCapacity = mCapacity;
+    mHeader->mMagic = LOG_BUFFER_RING_MAGIC;
+}
+
+size_t LogBufferRing::memorySize(uint32_t capacity) {
+    return sizeof(LogBufferRingHeader) + (size_t)capacity * sizeof(LogBufferSlot);
+}
+
+void LogBufferRing::append(const char* data, uint32_t len, uint64_t timestamp,
+                           const char* format, const char* tag, int32_t tid) {
+    unique_lock<mutex> guard;
+    if (nullptr != mAppendLock) {
+        guard = unique_lock<mutex>(*mAppendLock);
+    }
+    uint64_t head = mHeader->mHead.load(memory_order_relaxed);
+    LogBufferSlot& slot = mSlots[head % mCapacity];
+    uint32_t seq = slot.mSeq.load(memory_order_relaxed);
+    slot.mSeq.store(seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot.mIndex = head;
+    slot.mTimestamp = timestamp;
+    slot.mTid = tid;
+    if (nullptr != format && mInFile) {
+        // the file outlives the format and tag strings, so copies of them go
+        // ahead of the arguments
+        char* end = slot.mData + sizeof(slot.mData);
+        char* out = packString(slot.mData, end, (nullptr == tag) ? "" : tag);
+        out = packString(out, end, format);
+        len = std::min(len, (uint32_t)(end - out));
+        memcpy(out, data, len);
+        slot.mLen = out + len - slot.mData;
+        slot.mFlags = LOG_BUFFER_SLOT_PACKED;
+        slot.mFormat = nullptr;
+        slot.mTag = nullptr;
+    } else {
+        slot.mLen = std::min(len, (uint32_t)sizeof(slot.mData));
+        slot.mFlags = 0;
+        slot.mFormat = format;
+        slot.mTag = tag;
+        memcpy(slot.mData, data, slot.mLen);
+    }
+    slot.mSeq.store(seq + 2, memory_order_release);
+    mHeader->mHead.store(head + 1, memory_order_release);
+}
+
+void LogBufferRing::read(const function<void(const LogBufferSlot&)>& onLine) const {
+    LogBufferSlot line;
+    uint64_t head = mHeader->mHead.load(memory_order_acquire);
+    uint64_t index = std::max(mHeader->mFlushed.load(memory_order_acquire),
+                              (head > mCapacity) ? head - mCapacity : 0);
+    for (; index < head; index++) {
+        const LogBufferSlot& slot = mSlots[index % mCapacity];
+        uint32_t seq = slot.mSeq.load(memory_order_acquire);
+        line.mLen = std::min(slot.mLen, (uint32_t)sizeof(line.mData));
+        line.mIndex = slot.mIndex;
+        line.mTimestamp = slot.mTimestamp;
+        line.mTid = slot.mTid;
+        line.mFlags = slot.mFlags;
+        line.mFormat = slot.mFormat;
+        line.mTag = slot.mTag;
+        memcpy(line.mData, slot.mData, line.mLen);
+        atomic_thread_fence(memory_order_acquire);
+        // skip the lines overwritten while being copied
+        if (0 == (seq & 1) && seq == slot.mSeq.load(memory_order_relaxed) &&
+            line.mIndex == index) {
+            onLine(line);
+        }
+    }
+}
+
 LogBuffer* LogBuffer::getInstance() {
     if (mInstance == nullptr) {
         lock_guard<mutex> guard(sLock);
@@ -54,9 +177,10 @@ LogBuffer* LogBuffer::getInstance() {
     return mInstance;
 }
 
-LogBuffer::LogBuffer(): mLogList(TOTAL_LOG_LEVELS),
+LogBuffer::LogBuffer():
         mConfigVec(TOTAL_LOG_LEVELS, ConfigsInLevel(TIME_DEPTH_THRESHOLD_MINIMAL_IN_SEC,
-                    MAXIMUM_NUM_IN_LIST, 0)) {
+                    MAXIMUM_NUM_IN_LIST)),
+        mSlotsLeft(), mSharedRings(), mFileSizeKb(0), mFile(nullptr), mFileSize(0) {
     loc_param_s_type log_buff_config_table[] =
     {
         {"E_LEVEL_TIME_DEPTH",      &mConfigVec[0].mTimeDepthThres,  NULL, 'n'},
@@ -69,50 +193,552 @@ LogBuffer::LogBuffer(): mLogList(TOTAL_LOG_LEVELS),
         {"D_LEVEL_MAX_CAPACITY",    &mConfigVec[3].mMaxNumThres,     NULL, 'n'},
         {"V_LEVEL_TIME_DEPTH",      &mConfigVec[4].mTimeDepthThres,  NULL, 'n'},
         {"V_LEVEL_MAX_CAPACITY",    &mConfigVec[4].mMaxNumThres,     NULL, 'n'},
+        {"LOG_BUFFER_FILE_SIZE",    &mFileSizeKb,                    NULL, 'n'},
     };
     loc_read_conf(LOC_PATH_GPS_CONF_STR, log_buff_config_table,
             sizeof(log_buff_config_table)/sizeof(log_buff_config_table[0]));
+    for (int level = 0; level < TOTAL_LOG_LEVELS; level++) {
+        mSlotsLeft[level] = std::max(mConfigVec[level].mMaxNumThres, 1U);
+    }
+    if (mFileSizeKb > 0) {
+        mapFile();
+    }
     registerSignalHandler();
 }
 
-void LogBuffer::append(string& data, int level, uint64_t timestamp) {
-    lock_guard<mutex> guard(mLock);
-    pair<uint64_t, string> item(timestamp, data);
-    mLogList.append(item, level);
-    mConfigVec[level].mCurrentSize++;
+// Decodes the log buffer file left by the last run of this process, if any, to
+// LOG_BUFFER_FILE_PATH "gpslog_<process>_prev.log", then maps a new one.
+void LogBuffer::mapFile() {
+    char name[32] = "gnss";
+    FILE* comm = fopen("/proc/self/comm", "re");
+    if (nullptr != comm) {
+        if (nullptr != fgets(name, sizeof(name), comm)) {
+            name[strcspn(name, "\n")] = 0;
+        }
+        fclose(comm);
+    }
+    string path = string(LOG_BUFFER_FILE_PATH "gpslog_") + name;
+    string bufPath = path + ".buf";
+    if (0 == access(bufPath.c_str(), F_OK)) {
+        fstream s;
+        s.open(path + "_prev.log", std::fstream::out | std::fstream::trunc);
+        decodeFile(bufPath, [&s](stringstream& line){
+            s << line.str();
+        });
+        s.close();
+    }
+
+    mFileSize = (size_t)mFileSizeKb * 1024;
+    if (mFileSize < sizeof(LogBufferFileHeader)) {
+        return;
+    }
+    // the blocks are allocated up front: a write to a hole of the file that the
+    // file system then has no room for would raise SIGBUS
+    int fd = open(bufPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0660);
+    int err = (fd < 0) ? errno : posix_fallocate(fd, 0, mFileSize);
+    void* addr = MAP_FAILED;
+    if (0 == err) {
+        addr = mmap(nullptr, mFileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        err = (MAP_FAILED == addr) ? errno : 0;
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (0 != err) {
+        ALOGE("Log buffer file %s not mapped, err: %s", bufPath.c_str(), strerror(err));
+        return;
+    }
+
+    LogBufferFileHeader* file = new (addr) LogBufferFileHeader();
+    file->mVersion = LOG_BUFFER_FILE_VERSION;
+    file->mHeaderSize = sizeof(LogBufferFileHeader);
+    file->mRingHeaderSize = sizeof(LogBufferRingHeader);
+    file->mSlotSize = sizeof(LogBufferSlot);
+    file->mPid = getpid();
+    file->mBootToRealtime.store(getBootToRealtime(), memory_order_relaxed);
+    memcpy(file->mMagic, LOG_BUFFER_FILE_MAGIC, sizeof(file->mMagic));
+    mFile = file;
+}
+
+// The ring of the calling thread for level; the thread is given rings on
+// its first call, those of a thread gone if there is one, and a ring for
+// level on its first line in it.
+LogBufferRing* LogBuffer::getThreadRing(int level) {
+    LogBufferThread* thread = sThreadHolder.mThread;
+    if (nullptr == thread) {
+        lock_guard<mutex> guard(mLock);
+        for (auto t : mThreads) {
+            bool inUse = false;
+            if (t->mInUse.compare_exchange_strong(inUse, true, memory_order_acquire)) {
+                thread = t;
+                break;
+            }
+        }
+        if (nullptr == thread) {
+            thread = new LogBufferThread();
+            mThreads.push_back(thread);
+        }
+        sThreadHolder.mThread = thread;
+    }
+    LogBufferRing* ring = thread->mRings[level].load(memory_order_relaxed);
+    if (nullptr == ring) {
+        lock_guard<mutex> guard(mLock);
+        ring = takeRing(level);
+        thread->mRings[level].store(ring, memory_order_release);
+    }
+    return ring;
+}
+
+// A ring of one share of the slots left for level, as long as that leaves
+// the shared ring a share at least; the shared ring, with all the slots left,
+// otherwise. A share is never less than LOG_BUFFER_RING_MIN_SLOTS, so a level
+// with fewer than twice as many slots has the shared ring only, and keeps its
+// last lines across all threads. Called with mLock held.
+LogBufferRing* LogBuffer::takeRing(int level) {
+    uint32_t share = std::max(mConfigVec[level].mMaxNumThres / LOG_BUFFER_RING_SHARES,
+                              (uint32_t)LOG_BUFFER_RING_MIN_SLOTS);
+    if (mSlotsLeft[level] >= 2 * share) {
+        mSlotsLeft[level] -= share;
+        return newRing(share, level, false);
+    }
+    if (nullptr == mSharedRings[level]) {
+        mSharedRings[level] = newRing(std::max(mSlotsLeft[level], 1U), level, true);
+        mSlotsLeft[level] = 0;
+    }
+    return mSharedRings[level];
+}
+
+// A ring in the log buffer file while the file has room, on the heap
+// otherwise. Called with mLock held.
+LogBufferRing* LogBuffer::newRing(uint32_t capacity, int level, bool shared) {
+    if (nullptr != mFile) {
+        uint64_t used = mFile->mUsed.load(memory_order_relaxed);
+        size_t size = LogBufferRing::memorySize(capacity);
+        if (mFile->mHeaderSize + used + size <= mFileSize) {
+            LogBufferRing* ring = new LogBufferRing(capacity, level, shared,
+                                                    (char*)mFile + mFile->mHeaderSize + used);
+            mFile->mBootToRealtime.store(getBootToRealtime(), memory_order_relaxed);
+            // only now is the ring there for decodeFile()
+            mFile->mUsed.store(used + size, memory_order_release);
+            return ring;
+        }
+        ALOGE("Log buffer file full, level %s lines of this thread are kept in memory",
+              sLevelNames[level]);
+    }
+    return new LogBufferRing(capacity, level, shared);
+}
 
-    while ((timestamp - mLogList.front(level).first) > mConfigVec[level].mTimeDepthThres ||
-            mConfigVec[level].mCurrentSize > mConfigVec[level].mMaxNumThres) {
-        mLogList.pop(level);
-        mConfigVec[level].mCurrentSize--;
+// Each thread appends to rings of its own, with no lock taken and, once
+// they are created, no allocation; past the first threads logging in a level,
+// up to LOG_BUFFER_RING_SHARES - 1, to the shared ring of the level, under its
+// lock.
+void LogBuffer::append(const char* data, uint32_t len, int level, uint64_t timestamp) {
+    if (level < 0 || level >= TOTAL_LOG_LEVELS) {
+        return;
     }
+    getThreadRing(level)->append(data, len, timestamp);
+}
+
+void LogBuffer::appendBinary(const char* format, const char* args, uint32_t len, int level,
+                             uint64_t timestamp, const char* tag, int32_t tid) {
+    if (level < 0 || level >= TOTAL_LOG_LEVELS) {
+        return;
+    }
+    getThreadRing(level)->append(args, len, timestamp, format, tag, tid);
+}
+
+template <typename T>
+static inline int64_t readBinValue(const char* data) {
+    T value;
+    memcpy(&value, data, sizeof(value));
+    return (int64_t)value;
+}
+
+// Reads a packed integer of size bytes, extended to 64 bits as per isSigned
+static bool readBinInt(const char* data, uint32_t size, bool isSigned, int64_t& value) {
+    switch (size) {
+    case 1:
+        value = isSigned ? readBinValue<int8_t>(data) : readBinValue<uint8_t>(data);
+        return true;
+    case 2:
+        value = isSigned ? readBinValue<int16_t>(data) : readBinValue<uint16_t>(data);
+        return true;
+    case 4:
+        value = isSigned ? readBinValue<int32_t>(data) : readBinValue<uint32_t>(data);
+        return true;
+    case 8:
+        value = readBinValue<int64_t>(data);
+        return true;
+    default:
+        return false;
+    }
+}
+
+// value cut to its low size bytes, read back as signed or unsigned, as printf
+// would read an argument of that size
+static int64_t cutToSize(int64_t value, uint32_t size, bool isSigned) {
+    if (size >= sizeof(value)) {
+        return value;
+    }
+    uint32_t shift = 64 - 8 * size;
+    uint64_t bits = (uint64_t)value << shift;
+    return isSigned ? ((int64_t)bits >> shift) : (int64_t)(bits >> shift);
+}
+
+// size of the integer argument a printf length modifier asks for, 0 for none
+static uint32_t lengthModifierSize(const char* length, size_t len) {
+    if (0 == len) {
+        return 0;
+    }
+    switch (length[0]) {
+    case 'h':
+        return (len > 1 && 'h' == length[1]) ? sizeof(char) : sizeof(short);
+    case 'l':
+        return (len > 1 && 'l' == length[1]) ? sizeof(long long) : sizeof(long);
+    case 'L':
+    case 'q':
+        return sizeof(long long);
+    case 'j':
+        return sizeof(intmax_t);
+    case 'z':
+        return sizeof(size_t);
+    case 't':
+        return sizeof(ptrdiff_t);
+    default:
+        return 0;
+    }
+}
+
+// Formats the arguments of a binary line one conversion at a time, each
+// passed with the type it was recorded with. Conversions without a matching
+// argument print as "(?)".
+static void formatBinLine(string& out, const char* format, const char* args, uint32_t len) {
+    const char* pos = args;
+    const char* end = args + len;
+    // the next argument, converted to what the conversion expects
+    auto nextType = [&]() -> int {
+        return (pos < end) ? locBinLogType((uint8_t)*pos) : -1;
+    };
+    // integers come extended to 64 bits, with the size they were packed with
+    auto nextInt = [&](int64_t& value, uint32_t& size) -> bool {
+        int type = nextType();
+        size = (pos < end) ? locBinLogSize((uint8_t)*pos) : 0;
+        if ((LOC_BIN_LOG_INT == type || LOC_BIN_LOG_UINT == type || LOC_BIN_LOG_PTR == type) &&
+            end - pos >= (ptrdiff_t)(1 + size) &&
+            readBinInt(pos + 1, size, LOC_BIN_LOG_INT == type, value)) {
+            pos += 1 + size;
+            return true;
+        } else if (LOC_BIN_LOG_DOUBLE == type && sizeof(double) == size &&
+                   end - pos >= (ptrdiff_t)(1 + sizeof(double))) {
+            double d;
+            memcpy(&d, pos + 1, sizeof(d));
+            value = (int64_t)d;
+            pos += 1 + sizeof(d);
+            return true;
+        }
+        return false;
+    };
+    auto nextDouble = [&](double& value) -> bool {
+        int64_t i;
+        uint32_t size;
+        if (LOC_BIN_LOG_DOUBLE == nextType() && end - pos >= (ptrdiff_t)(1 + sizeof(value))) {
+            memcpy(&value, pos + 1, sizeof(value));
+            pos += 1 + sizeof(value);
+            return true;
+        } else if (LOC_BIN_LOG_INT == nextType() && nextInt(i, size)) {
+            value = i;
+            return true;
+        } else if (LOC_BIN_LOG_UINT == nextType() && nextInt(i, size)) {
+            value = (uint64_t)i;
+            return true;
+        }
+        return false;
+    };
+    auto nextString = [&](string& value) -> bool {
+        uint16_t l;
+        if (LOC_BIN_LOG_STR == nextType() && end - pos >= (ptrdiff_t)(1 + sizeof(l))) {
+            memcpy(&l, pos + 1, sizeof(l));
+            l = std::min((size_t)l, (size_t)(end - pos) - 1 - sizeof(l));
+            value.assign(pos + 1 + sizeof(l), l);
+            pos += 1 + sizeof(l) + l;
+            return true;
+        }
+        return false;
+    };
+
+    char buf[LOGGING_BUFFER_MAX_LEN];
+    const char* p = format;
+    while (*p) {
+        const char* percent = strchr(p, '%');
+        if (nullptr == percent) {
+            out.append(p);
+            break;
+        }
+        out.append(p, percent - p);
+        if ('%' == percent[1]) {
+            out.push_back('%');
+            p = percent + 2;
+            continue;
+        }
+        // % [flags] [width] [.precision] [length] conversion; integers are cut
+        // to the size of the length, or else of the argument, and passed as
+        // long long, floating point numbers as double
+        string spec("%");
+        int stars = 0;
+        int starValues[2] = {0, 0};
+        const char* q = percent + 1;
+        for (; *q && nullptr != strchr("-+ #0", *q); q++) {
+            spec.push_back(*q);
+        }
+        for (; *q && (isdigit(*q) || '.' == *q || '*' == *q); q++) {
+            if ('*' == *q && stars < 2) {
+                int64_t value = 0;
+                uint32_t size = 0;
+                nextInt(value, size);
+                starValues[stars++] = (int)value;
+            }
+            spec.push_back(*q);
+        }
+        const char* length = q;
+        for (; *q && nullptr != strchr("hlLqjzt", *q); q++);
+        uint32_t lengthSize = lengthModifierSize(length, q - length);
+        if (0 == *q) {
+            break;
+        }
+        char conversion = *q;
+        p = q + 1;
+
+        int n = -1;
+        int64_t i;
+        uint32_t size;
+        double d;
+        string str;
+        #define FORMAT_WITH_STARS(fmt, value) \
+            ((0 == stars) ? snprintf(buf, sizeof(buf), fmt, value) : \
+             (1 == stars) ? snprintf(buf, sizeof(buf), fmt, starValues[0], value) : \
+             snprintf(buf, sizeof(buf), fmt, starValues[0], starValues[1], value))
+        if (nullptr != strchr("dioux", tolower(conversion))) {
+            spec.append("ll").push_back(conversion);
+            if (nextInt(i, size)) {
+                bool isSigned = ('d' == conversion || 'i' == conversion);
+                i = cutToSize(i, (0 != lengthSize) ? lengthSize : size, isSigned);
+                n = FORMAT_WITH_STARS(spec.c_str(), (long long)i);
+            }
+        } else if ('c' == conversion) {
+            spec.push_back(conversion);
+            if (nextInt(i, size)) {
+                n = FORMAT_WITH_STARS(spec.c_str(), (int)i);
+            }
+        } else if (nullptr != strchr("efga", tolower(conversion))) {
+            spec.push_back(conversion);
+            if (nextDouble(d)) {
+                n = FORMAT_WITH_STARS(spec.c_str(), d);
+            }
+        } else if ('s' == conversion) {
+            spec.push_back(conversion);
+            if (nextString(str)) {
+                n = FORMAT_WITH_STARS(spec.c_str(), str.c_str());
+            }
+        } else if ('p' == conversion) {
+            spec.push_back(conversion);
+            if (nextInt(i, size)) {
+                n = FORMAT_WITH_STARS(spec.c_str(), (void*)(uintptr_t)i);
+            }
+        }
+        #undef FORMAT_WITH_STARS
+        if (n >= 0) {
+            out.append(buf, std::min((size_t)n, sizeof(buf) - 1));
+        } else {
+            out.append("(?)");
+        }
+    }
+}
+
+// The text of a line: text lines as they were logged, binary lines formatted as
+// log_buffer_insert() would have (see INSERT_BUFFER), with the wall clock time
+// worked out from the boot time
+static void formatLine(string& out, const LogBufferSlot& line, int32_t pid,
+                       uint64_t bootToRealtime) {
+    const char* format = line.mFormat;
+    const char* tag = line.mTag;
+    const char* args = line.mData;
+    uint32_t len = line.mLen;
+    if (0 != (line.mFlags & LOG_BUFFER_SLOT_PACKED)) {
+        size_t tagLen = strnlen(line.mData, len);
+        size_t formatLen = (tagLen < len) ? strnlen(line.mData + tagLen + 1, len - tagLen - 1) : 0;
+        if (tagLen + 1 + formatLen >= len) {
+            out.append("(?)");
+            return;
+        }
+        tag = line.mData;
+        format = tag + tagLen + 1;
+        args = format + formatLen + 1;
+        len -= args - line.mData;
+    }
+    if (nullptr == format) {
+        out.assign(line.mData, line.mLen);
+        return;
+    }
+    uint64_t realtime = line.mTimestamp + bootToRealtime;
+    time_t sec = realtime / 1000000000ULL;
+    char head[96];
+    snprintf(head, sizeof(head), "%02d:%02d:%02d.%06ld %d %d %s :",
+             (int)(sec / 3600 % 24), (int)(sec % 3600 / 60), (int)(sec % 60),
+             (long)(realtime % 1000000000ULL / 1000), pid, line.mTid, tag);
+    out = head;
+    formatBinLine(out, format, args, len);
+}
+
+struct LogBufferLine {
+    uint64_t mTimestamp;
+    int mLevel;
+    string mData;
+};
+
+// Logs the lines of all the rings, merged by timestamp
+static void logLines(vector<LogBufferLine>& li, std::function<void(stringstream&)>& log) {
+    // lines of the same thread and level are already in order
+    stable_sort(li.begin(), li.end(), [](const LogBufferLine& a, const LogBufferLine& b) {
+        return a.mTimestamp < b.mTimestamp;
+    });
+    for_each (li.begin(), li.end(), [&](const LogBufferLine &item){
+        stringstream line;
+        line << "["<< item.mTimestamp / 1000000000ULL << "] ";
+        line << "Level " << sLevelNames[item.mLevel] << ": ";
+        line << item.mData << endl;
+        if (log != nullptr) {
+            log(line);
+        }
+    });
 }
 
 //Dump the log buffer of specific level, level = -1 to dump all the levels in log buffer.
+//The lines of all the threads are merged by timestamp; in each level, only those within
+//X_LEVEL_TIME_DEPTH seconds of the latest one are dumped.
 void LogBuffer::dump(std::function<void(stringstream&)> log, int level) {
-    lock_guard<mutex> guard(mLock);
-    list<pair<pair<uint64_t, string>, int>> li;
-    if (-1 == level) {
-        li = mLogList.dump();
-    } else {
-        li = mLogList.dump(level);
+    vector<LogBufferLine> li;
+    uint64_t latest[TOTAL_LOG_LEVELS] = {};
+    uint64_t bootToRealtime = getBootToRealtime();
+    {
+        lock_guard<mutex> guard(mLock);
+        auto read = [&](LogBufferRing* ring, int l) {
+            ring->read([&](const LogBufferSlot& line) {
+                li.push_back({line.mTimestamp, l, ""});
+                formatLine(li.back().mData, line, getpid(), bootToRealtime);
+                latest[l] = std::max(latest[l], line.mTimestamp);
+            });
+        };
+        for (int l = 0; l < TOTAL_LOG_LEVELS; l++) {
+            if (-1 != level && l != level) {
+                continue;
+            }
+            for (auto thread : mThreads) {
+                LogBufferRing* ring = thread->mRings[l].load(memory_order_acquire);
+                // the shared ring is read once, below
+                if (nullptr != ring && !ring->isShared()) {
+                    read(ring, l);
+                }
+            }
+            if (nullptr != mSharedRings[l]) {
+                read(mSharedRings[l], l);
+            }
+        }
     }
+    li.erase(remove_if(li.begin(), li.end(), [&, this](const LogBufferLine& line) {
+        return (latest[line.mLevel] - line.mTimestamp) / 1000000000ULL >
+                mConfigVec[line.mLevel].mTimeDepthThres;
+    }), li.end());
+
     ALOGE("Begining of dump, buffer size: %d", (int)li.size());
     stringstream ln;
     ln << "dump log buffer, level[" << level << "]" << ", buffer size: " << li.size() << endl;
     log(ln);
-    for_each (li.begin(), li.end(), [&, this](const pair<pair<uint64_t, string>, int> &item){
-        stringstream line;
-        line << "["<<item.first.first << "] ";
-        line << "Level " << mLevelMap[item.second] << ": ";
-        line << item.first.second << endl;
-        if (log != nullptr) {
-            log(line);
-        }
-    });
+    logLines(li, log);
     ALOGE("End of dump");
 }
 
+//Decode a log buffer file, as left by a process that crashed or by a running one. The
+//lines of all its rings are merged by timestamp, none are left out for X_LEVEL_TIME_DEPTH.
+//Returns false if the file is not a log buffer file of LOG_BUFFER_FILE_VERSION.
+bool LogBuffer::decodeFile(const string& filePath, std::function<void(stringstream&)> log) {
+    struct stat st;
+    int fd = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(LogBufferFileHeader)) {
+        ALOGE("Log buffer file %s not decoded, err: %s", filePath.c_str(), strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+    size_t size = st.st_size;
+    void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (MAP_FAILED == addr) {
+        ALOGE("Log buffer file %s not decoded, err: %s", filePath.c_str(), strerror(errno));
+        return false;
+    }
+
+    const char* base = (const char*)addr;
+    const LogBufferFileHeader* file = (const LogBufferFileHeader*)addr;
+    if (0 != memcmp(file->mMagic, LOG_BUFFER_FILE_MAGIC, sizeof(file->mMagic)) ||
+        LOG_BUFFER_FILE_VERSION != file->mVersion ||
+        file->mHeaderSize < sizeof(LogBufferFileHeader) || file->mHeaderSize > size ||
+        file->mRingHeaderSize < sizeof(LogBufferRingHeader) ||
+        file->mSlotSize < offsetof(LogBufferSlot, mData) || 0 != file->mSlotSize % 8) {
+        ALOGE("%s is not a log buffer file of version %d", filePath.c_str(),
+              LOG_BUFFER_FILE_VERSION);
+        munmap(addr, size);
+        return false;
+    }
+
+    // the slots may be of another build: only their fields up to mData are read
+    vector<LogBufferLine> li;
+    LogBufferSlot line = {};
+    uint32_t maxLen = std::min((size_t)file->mSlotSize - offsetof(LogBufferSlot, mData),
+                               sizeof(line.mData));
+    uint64_t bootToRealtime = file->mBootToRealtime.load(memory_order_relaxed);
+    uint64_t end = std::min((uint64_t)size,
+                            file->mHeaderSize + file->mUsed.load(memory_order_acquire));
+    for (uint64_t offset = file->mHeaderSize; offset + file->mRingHeaderSize <= end; ) {
+        const LogBufferRingHeader* ring = (const LogBufferRingHeader*)(base + offset);
+        uint64_t capacity = ring->mCapacity;
+        uint64_t ringSize = file->mRingHeaderSize + capacity * file->mSlotSize;
+        if (LOG_BUFFER_RING_MAGIC != ring->mMagic || ring->mLevel >= TOTAL_LOG_LEVELS ||
+            0 == capacity || offset + ringSize > end) {
+            break;
+        }
+        const char* slots = base + offset + file->mRingHeaderSize;
+        uint64_t head = ring->mHead.load(memory_order_relaxed);
+        uint64_t index = std::max(ring->mFlushed.load(memory_order_relaxed),
+                                  (head > capacity) ? head - capacity : 0);
+        for (; index < head; index++) {
+            const LogBufferSlot* slot =
+                    (const LogBufferSlot*)(slots + (index % capacity) * file->mSlotSize);
+            // left out, the lines being written when the process stopped
+            if (0 != (slot->mSeq.load(memory_order_relaxed) & 1) || slot->mIndex != index) {
+                continue;
+            }
+            line.mLen = std::min(slot->mLen, maxLen);
+            line.mTimestamp = slot->mTimestamp;
+            line.mTid = slot->mTid;
+            line.mFlags = slot->mFlags;
+            memcpy(line.mData, slot->mData, line.mLen);
+            li.push_back({line.mTimestamp, (int)ring->mLevel, ""});
+            formatLine(li.back().mData, line, file->mPid, bootToRealtime);
+        }
+        offset += ringSize;
+    }
+    int32_t pid = file->mPid;
+    munmap(addr, size);
+
+    stringstream ln;
+    ln << "decode log buffer file " << filePath << ", pid: " << pid
+       << ", buffer size: " << li.size() << endl;
+    log(ln);
+    logLines(li, log);
+    return true;
+}
+
 void LogBuffer::dumpToAdbLogcat() {
     dump([](stringstream& line){
         ALOGE("%s", line.str().c_str());
@@ -130,7 +756,20 @@ void LogBuffer::dumpToLogFile(string filePath) {
 }
 
 void LogBuffer::flush() {
-    mLogList.flush();
+    lock_guard<mutex> guard(mLock);
+    for (auto thread : mThreads) {
+        for (auto& ring : thread->mRings) {
+            LogBufferRing* r = ring.load(memory_order_acquire);
+            if (nullptr != r && !r->isShared()) {
+                r->flush();
+            }
+        }
+    }
+    for (auto ring : mSharedRings) {
+        if (nullptr != ring) {
+            ring->flush();
+        }
+    }
 }
 
 void LogBuffer::registerSignalHandler() {
@@ -150,35 +789,38 @@ void LogBuffer::registerSignalHandler() {
 void LogBuffer::signalHandler(const int code, siginfo_t *const si, void *const sc) {
     ALOGE("[Gnss Log buffer]Singal handler, signal ID: %d", code);
 
+    //With the log buffer file, the lines are already where the next start of the
+    //process decodes them from: nothing is done here but on SIGUSR1
+    if (nullptr == mInstance->mFile || code == SIGUSR1) {
 #ifdef USE_GLIB
-    int nptrs;
-    void *buffer[100];
-    char **strings;
+        int nptrs;
+        void *buffer[100];
+        char **strings;
 
-    nptrs = backtrace(buffer, sizeof(buffer)/sizeof(*buffer));
-    strings = backtrace_symbols(buffer, nptrs);
-    if (strings != NULL) {
-        timespec tv;
-        clock_gettime(CLOCK_BOOTTIME, &tv);
-        uint64_t elapsedTime = (uint64_t)tv.tv_sec + (uint64_t)tv.tv_nsec/1000000000;
-        for (int i = 0; i < nptrs; i++) {
-            string s(strings[i]);
-            mInstance->append(s, 0, elapsedTime);
+        nptrs = backtrace(buffer, sizeof(buffer)/sizeof(*buffer));
+        strings = backtrace_symbols(buffer, nptrs);
+        if (strings != NULL) {
+            timespec tv;
+            clock_gettime(CLOCK_BOOTTIME, &tv);
+            uint64_t elapsedTime = (uint64_t)tv.tv_sec * 1000000000ULL + (uint64_t)tv.tv_nsec;
+            for (int i = 0; i < nptrs; i++) {
+                mInstance->append(strings[i], strlen(strings[i]), 0, elapsedTime);
+            }
         }
-    }
 #endif
-    //Dump the log buffer to adb logcat
-    mInstance->dumpToAdbLogcat();
-
-    //Dump the log buffer to file
-    time_t now = time(NULL);
-    struct tm *curr_time = localtime(&now);
-    char path[50];
-    snprintf(path, 50, LOG_BUFFER_FILE_PATH "gpslog_%d%d%d-%d%d%d.log",
-            (1900 + curr_time->tm_year), ( 1 + curr_time->tm_mon), curr_time->tm_mday,
-            curr_time->tm_hour, curr_time->tm_min, curr_time->tm_sec);
-
-    mInstance->dumpToLogFile(path);
+        //Dump the log buffer to adb logcat
+        mInstance->dumpToAdbLogcat();
+
+        //Dump the log buffer to file
+        time_t now = time(NULL);
+        struct tm *curr_time = localtime(&now);
+        char path[50];
+        snprintf(path, 50, LOG_BUFFER_FILE_PATH "gpslog_%d%d%d-%d%d%d.log",
+                (1900 + curr_time->tm_year), ( 1 + curr_time->tm_mon), curr_time->tm_mday,
+                curr_time->tm_hour, curr_time->tm_min, curr_time->tm_sec);
+
+        mInstance->dumpToLogFile(path);
+    }
 
     //Process won't be terminated if SIGUSR1 is recieved
     if (code != SIGUSR1) {
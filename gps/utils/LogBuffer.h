@@ -30,7 +30,6 @@
 #ifndef LOG_BUFFER_H
 #define LOG_BUFFER_H
 
-#include "SkipList.h"
 #include "log_util.h"
 #include <loc_cfg.h>
 #include <loc_pla.h>
@@ -43,6 +42,9 @@
 #include <signal.h>
 #include <thread>
 #include <functional>
+#include <atomic>
+#include <memory>
+#include <vector>
 
 //default error level time depth threshold,
 #define TIME_DEPTH_THRESHOLD_MINIMAL_IN_SEC 60
@@ -50,6 +52,19 @@
 #define MAXIMUM_NUM_IN_LIST 50
 //file path of dumped log buffer
 #define LOG_BUFFER_FILE_PATH "/data/vendor/location/"
+//log buffer file, see LogBufferFileHeader
+#define LOG_BUFFER_FILE_MAGIC "LOCLOGB"
+#define LOG_BUFFER_FILE_VERSION 2
+#define LOG_BUFFER_RING_MAGIC 0x474e4952
+//LogBufferSlot mFlags: mData holds tag '\0' format '\0' packed arguments
+#define LOG_BUFFER_SLOT_PACKED 0x1
+//X_LEVEL_MAX_CAPACITY is split in as many shares, of LOG_BUFFER_RING_MIN_SLOTS
+//at least: each of the first threads logging in a level gets a ring of one
+//share, the others share the rest
+#define LOG_BUFFER_RING_SHARES 8
+#define LOG_BUFFER_RING_MIN_SLOTS 32
+
+using namespace std;
 
 namespace loc_util {
 
@@ -57,10 +72,100 @@ class ConfigsInLevel{
 public:
     uint32_t mTimeDepthThres;
     uint32_t mMaxNumThres;
-    int mCurrentSize;
 
-    ConfigsInLevel(uint32_t time, int num, int size):
-        mTimeDepthThres(time), mMaxNumThres(num), mCurrentSize(size) {}
+    ConfigsInLevel(uint32_t time, int num):
+        mTimeDepthThres(time), mMaxNumThres(num) {}
+};
+
+// One line of the log buffer. mSeq is odd while the line is being written,
+// so that a dump running meanwhile can tell that its copy is torn.
+// Slots are also the records of the log buffer file: the fields up to
+// mData have the same layout on 32 and 64 bit builds.
+struct LogBufferSlot {
+    atomic<uint32_t> mSeq;
+    uint32_t mLen;
+    uint64_t mIndex;            // of the line in its ring, see LogBufferRing
+    uint64_t mTimestamp;        // CLOCK_BOOTTIME, in ns
+    int32_t mTid;               // binary lines only
+    uint32_t mFlags;            // LOG_BUFFER_SLOT_*
+    char mData[LOGGING_BUFFER_MAX_LEN];
+    // binary lines only, see LocBinLog.h: mData holds the packed arguments;
+    // never set in the log buffer file, where the lines are packed instead
+    const char* mFormat;        // nullptr for text lines
+    const char* mTag;
+};
+
+// The head of a ring, followed by its slots
+struct LogBufferRingHeader {
+    uint32_t mMagic;            // LOG_BUFFER_RING_MAGIC
+    uint32_t mLevel;
+    uint32_t mCapacity;
+    uint32_t mReserved;
+    // lines ever appended, and the first one not flushed
+    atomic<uint64_t> mHead;
+    atomic<uint64_t> mFlushed;
+};
+
+// The log buffer file, LOG_BUFFER_FILE_PATH "gpslog_<process>.buf", with
+// LOG_BUFFER_FILE_SIZE set in gps.conf: a header followed by the rings,
+// mapped shared so that the lines are in the file as soon as they are
+// appended, and are left there by a crash. Rings are set up one after the
+// other, and counted in mUsed once complete. LOG_BUFFER_FILE_VERSION is
+// bumped with any change to the layout of this header, LogBufferRingHeader
+// or LogBufferSlot up to mData, or to the packing of binary lines in mData,
+// see LocBinLog.h.
+struct LogBufferFileHeader {
+    char mMagic[8];             // LOG_BUFFER_FILE_MAGIC
+    uint32_t mVersion;
+    uint32_t mHeaderSize;       // offset of the first ring
+    uint32_t mRingHeaderSize;
+    uint32_t mSlotSize;
+    int32_t mPid;
+    uint32_t mReserved;
+    atomic<uint64_t> mUsed;     // bytes of complete rings, from mHeaderSize
+    // CLOCK_REALTIME - CLOCK_BOOTTIME as of the last ring set up, in ns
+    atomic<uint64_t> mBootToRealtime;
+};
+
+// The lines of one level logged by one thread, the last mCapacity of them.
+// Only the owning thread appends, without locking or waiting; dump() and
+// flush() may run on any thread. A shared ring is appended to by the
+// threads left without a ring of their own, under mAppendLock.
+class LogBufferRing {
+    const uint32_t mCapacity;
+    // heap rings only; file rings live in the log buffer file
+    unique_ptr<char[]> mMemory;
+    LogBufferRingHeader* mHeader;
+    LogBufferSlot* mSlots;
+    const bool mInFile;
+    // shared rings only
+    unique_ptr<mutex> mAppendLock;
+public:
+    // memory, if not null, is memorySize(capacity) bytes of the log buffer file
+    LogBufferRing(uint32_t capacity, int level, bool shared, void* memory = nullptr);
+    static size_t memorySize(uint32_t capacity);
+    inline bool isShared() const { return nullptr != mAppendLock; }
+    void append(const char* data, uint32_t len, uint64_t timestamp,
+                const char* format = nullptr, const char* tag = nullptr, int32_t tid = 0);
+    // calls onLine() with a copy of each line still in the ring, oldest first
+    void read(const function<void(const LogBufferSlot&)>& onLine) const;
+    inline void flush() {
+        mHeader->mFlushed.store(mHeader->mHead.load(memory_order_acquire), memory_order_release);
+    }
+};
+
+// The rings of one thread, set up as the thread first logs in each level:
+// one of its own or the shared one of the level. Rings outlive their thread,
+// so that its last lines still get dumped; a new thread takes over the rings
+// of one that is gone.
+struct LogBufferThread {
+    atomic<LogBufferRing*> mRings[TOTAL_LOG_LEVELS];
+    atomic<bool> mInUse;
+    inline LogBufferThread() : mInUse(true) {
+        for (auto& ring : mRings) {
+            ring.store(nullptr);
+        }
+    }
 };
 
 class LogBuffer {
@@ -70,21 +175,43 @@ private:
     static struct sigaction mNewSigAction;
     static mutex sLock;
 
-    SkipList<pair<uint64_t, string>> mLogList;
+    // all the LogBufferThreads ever created, never freed
+    vector<LogBufferThread*> mThreads;
     vector<ConfigsInLevel> mConfigVec;
     mutex mLock;
-
-    const vector<string> mLevelMap {"E", "W", "I", "D", "V"};
+    // X_LEVEL_MAX_CAPACITY bounds the lines of a level in the whole process:
+    // the slots of it not given to a ring yet, and the shared ring taking
+    // the rest once the first threads got theirs; guarded by mLock
+    uint32_t mSlotsLeft[TOTAL_LOG_LEVELS];
+    LogBufferRing* mSharedRings[TOTAL_LOG_LEVELS];
+    // LOG_BUFFER_FILE_SIZE of gps.conf, in KB, and the log buffer file mapped
+    // if it is set; rings are set up in the file while it has room
+    uint32_t mFileSizeKb;
+    LogBufferFileHeader* mFile;
+    size_t mFileSize;
 
 public:
     static LogBuffer* getInstance();
-    void append(string& data, int level, uint64_t timestamp);
+    // timestamp is CLOCK_BOOTTIME in ns
+    void append(const char* data, uint32_t len, int level, uint64_t timestamp);
+    inline void append(string& data, int level, uint64_t timestamp) {
+        append(data.data(), data.size(), level, timestamp);
+    }
+    // a binary line, args as packed by LocBinLogWriter
+    void appendBinary(const char* format, const char* args, uint32_t len, int level,
+                      uint64_t timestamp, const char* tag, int32_t tid);
     void dump(std::function<void(stringstream&)> log, int level = -1);
     void dumpToAdbLogcat();
     void dumpToLogFile(string filePath);
     void flush();
+    // logs the lines left in a log buffer file, by this or an earlier process
+    static bool decodeFile(const string& filePath, std::function<void(stringstream&)> log);
 private:
     LogBuffer();
+    void mapFile();
+    LogBufferRing* getThreadRing(int level);
+    LogBufferRing* takeRing(int level);
+    LogBufferRing* newRing(uint32_t capacity, int level, bool shared);
     void registerSignalHandler();
     static void signalHandler(const int code, siginfo_t *const si, void *const sc);
 
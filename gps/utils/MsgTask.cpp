@@ -30,6 +30,17 @@
 #define LOG_TAG "LocSvc_MsgTask"
 
 #include <unistd.h>
+#include <inttypes.h>
+#include <time.h>
+#include <dlfcn.h>
+#include <cxxabi.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 #include <MsgTask.h>
 #include <msg_q.h>
 #include <log_util.h>
@@ -38,10 +49,264 @@
 
 namespace loc_util {
 
+static inline uint64_t getMonotonicNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// log2 histogram of durations, bucket 0 counts < 1us, bucket i counts
+// [2^(i-1), 2^i) us and the last bucket is open ended
+struct LocDurationHist {
+    static const uint32_t kBuckets = 20;
+    uint64_t mCount;
+    uint64_t mTotalNs;
+    uint64_t mMaxNs;
+    uint32_t mBuckets[kBuckets];
+
+    inline LocDurationHist() : mCount(0), mTotalNs(0), mMaxNs(0), mBuckets{} {}
+    inline void add(uint64_t ns) {
+        uint64_t us = ns / 1000;
+        uint32_t bucket = 0;
+        while (us > 0 && bucket < kBuckets - 1) {
+            us >>= 1;
+            bucket++;
+        }
+        mBuckets[bucket]++;
+        mCount++;
+        mTotalNs += ns;
+        if (ns > mMaxNs) {
+            mMaxNs = ns;
+        }
+    }
+    // upper bound in us of the bucket holding the pct percentile
+    inline uint64_t percentileUs(uint32_t pct) const {
+        uint64_t target = (mCount * pct + 99) / 100;
+        uint64_t seen = 0;
+        for (uint32_t i = 0; i < kBuckets; i++) {
+            seen += mBuckets[i];
+            if (seen >= target) {
+                return (1ULL << i);
+            }
+        }
+        return (1ULL << (kBuckets - 1));
+    }
+    void dump(std::string& out, const char* label) const {
+        char buf[160];
+        snprintf(buf, sizeof(buf), "  %s(us): avg %" PRIu64 " max %" PRIu64
+                 " p50<%" PRIu64 " p99<%" PRIu64 " |",
+                 label, mCount ? mTotalNs / mCount / 1000 : 0, mMaxNs / 1000,
+                 percentileUs(50), percentileUs(99));
+        out += buf;
+        for (uint32_t i = 0; i < kBuckets; i++) {
+            snprintf(buf, sizeof(buf), " %u", mBuckets[i]);
+            out += buf;
+        }
+        out += "\n";
+    }
+};
+
+// Stats of one MsgTask, shared by the MsgTask and its MTRunnable. Enqueue
+// accounting runs on producer threads and is lock free; everything else is
+// recorded by the MsgTask thread under mLock, which only dumpStats() contends.
+// Queue depth is sampled from the msg_q, which alone knows about msgs dropped
+// or superseded while queued.
+class MsgTaskStats {
+    struct TypeStats {
+        uint64_t mCount;
+        LocDurationHist mLatency;
+        LocDurationHist mProc;
+        inline TypeStats() : mCount(0) {}
+    };
+
+    std::atomic<bool> mEnabled;
+    std::atomic<uint32_t> mDepthHighWater;
+    std::atomic<uint32_t> mWindowDepthHighWater;
+    mutable std::mutex mLock;
+    uint64_t mLogIntervalNs;
+    uint64_t mLastLogNs;
+    // window of the periodic log line
+    uint32_t mWindowCount;
+    uint64_t mWindowMaxLatencyNs;
+    const void* mWindowMaxLatencyType;
+    uint64_t mWindowMaxProcNs;
+    const void* mWindowMaxProcType;
+    // keyed by the vtable of the LocMsg, i.e. its dynamic type
+    std::unordered_map<const void*, TypeStats> mTypes;
+
+    static std::string typeName(const void* type);
+    void logWindow(uint64_t nowNs);
+
+public:
+    inline MsgTaskStats() : mEnabled(false), mDepthHighWater(0), mWindowDepthHighWater(0),
+        mLogIntervalNs(0), mLastLogNs(0), mWindowCount(0),
+        mWindowMaxLatencyNs(0), mWindowMaxLatencyType(nullptr),
+        mWindowMaxProcNs(0), mWindowMaxProcType(nullptr) {}
+
+    inline bool isEnabled() const { return mEnabled.load(std::memory_order_relaxed); }
+    inline void enable(uint32_t logIntervalSec) {
+        std::lock_guard<std::mutex> lock(mLock);
+        mLogIntervalNs = (uint64_t)logIntervalSec * 1000000000ULL;
+        mLastLogNs = getMonotonicNs();
+        mEnabled.store(true, std::memory_order_relaxed);
+    }
+    inline void disable() { mEnabled.store(false, std::memory_order_relaxed); }
+
+    inline static void updateHighWater(std::atomic<uint32_t>& highWater, uint32_t depth) {
+        uint32_t cur = highWater.load(std::memory_order_relaxed);
+        while (depth > cur &&
+               !highWater.compare_exchange_weak(cur, depth, std::memory_order_relaxed)) {}
+    }
+    // stamps msg before it is queued
+    inline void onEnqueue(const LocMsg* msg) { msg->mEnqueueTimeNs = getMonotonicNs(); }
+    // depth sampled right after a msg is queued
+    inline void onDepth(uint32_t depth) {
+        updateHighWater(mDepthHighWater, depth);
+        updateHighWater(mWindowDepthHighWater, depth);
+    }
+    // type and enqueueNs are sampled before proc(), as the msg may be gone after
+    void onProc(const void* type, uint64_t enqueueNs, uint64_t startNs, uint64_t endNs);
+    void dump(std::string& out, uint32_t depth) const;
+};
+
+void MsgTaskStats::onProc(const void* type, uint64_t enqueueNs,
+                          uint64_t startNs, uint64_t endNs) {
+    uint64_t latencyNs = (startNs > enqueueNs) ? startNs - enqueueNs : 0;
+    uint64_t procNs = endNs - startNs;
+
+    std::lock_guard<std::mutex> lock(mLock);
+    TypeStats& stats = mTypes[type];
+    stats.mCount++;
+    stats.mLatency.add(latencyNs);
+    stats.mProc.add(procNs);
+
+    mWindowCount++;
+    if (latencyNs >= mWindowMaxLatencyNs) {
+        mWindowMaxLatencyNs = latencyNs;
+        mWindowMaxLatencyType = type;
+    }
+    if (procNs >= mWindowMaxProcNs) {
+        mWindowMaxProcNs = procNs;
+        mWindowMaxProcType = type;
+    }
+    if (mLogIntervalNs > 0 && endNs - mLastLogNs >= mLogIntervalNs) {
+        logWindow(endNs);
+    }
+}
+
+// mLock must be held
+void MsgTaskStats::logWindow(uint64_t nowNs) {
+    LOC_LOGi("%u msgs in %" PRIu64 " ms, depth high water %u, "
+             "max latency %" PRIu64 " us (%s), max proc %" PRIu64 " us (%s)",
+             mWindowCount, (nowNs - mLastLogNs) / 1000000,
+             mWindowDepthHighWater.exchange(0, std::memory_order_relaxed),
+             mWindowMaxLatencyNs / 1000, typeName(mWindowMaxLatencyType).c_str(),
+             mWindowMaxProcNs / 1000, typeName(mWindowMaxProcType).c_str());
+    mLastLogNs = nowNs;
+    mWindowCount = 0;
+    mWindowMaxLatencyNs = 0;
+    mWindowMaxLatencyType = nullptr;
+    mWindowMaxProcNs = 0;
+    mWindowMaxProcType = nullptr;
+}
+
+// Android builds go without RTTI, so the type is named after its vtable symbol
+// if that is exported, or else as library+offset of the vtable, which can be
+// resolved offline against the unstripped library.
+std::string MsgTaskStats::typeName(const void* type) {
+    if (nullptr == type) {
+        return "none";
+    }
+    char buf[256];
+    Dl_info info;
+    if (0 == dladdr(type, &info)) {
+        snprintf(buf, sizeof(buf), "%p", type);
+        return buf;
+    }
+    // a vtable pointer points past the offset to top and typeinfo entries
+    if (nullptr != info.dli_sname && 0 == strncmp(info.dli_sname, "_ZTV", 4) &&
+        (const char*)type - (const char*)info.dli_saddr == 2 * sizeof(void*)) {
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(info.dli_sname + 4, nullptr, nullptr, &status);
+        if (nullptr != demangled) {
+            std::string name(demangled);
+            free(demangled);
+            return name;
+        }
+        return info.dli_sname;
+    }
+    const char* lib = (nullptr != info.dli_fname) ? strrchr(info.dli_fname, '/') : nullptr;
+    snprintf(buf, sizeof(buf), "%s+0x%zx",
+             (nullptr != lib) ? lib + 1 : (nullptr != info.dli_fname ? info.dli_fname : "?"),
+             (size_t)((const char*)type - (const char*)info.dli_fbase));
+    return buf;
+}
+
+void MsgTaskStats::dump(std::string& out, uint32_t depth) const {
+    char buf[256];
+    std::lock_guard<std::mutex> lock(mLock);
+    snprintf(buf, sizeof(buf), "MsgTask stats %s, depth %u, depth high water %u, %zu types\n",
+             isEnabled() ? "enabled" : "disabled", depth,
+             mDepthHighWater.load(std::memory_order_relaxed), mTypes.size());
+    out += buf;
+    for (auto& it : mTypes) {
+        snprintf(buf, sizeof(buf), " %s: %" PRIu64 " msgs\n",
+                 typeName(it.first).c_str(), it.second.mCount);
+        out += buf;
+        it.second.mLatency.dump(out, "latency");
+        it.second.mProc.dump(out, "proc");
+    }
+}
+
+static void LocMsgProcBatch(void** msgs, uint32_t count, MsgTaskStats& stats) {
+    for (uint32_t i = 0; i < count; i++) {
+        LocMsg* msg = (LocMsg*)msgs[i];
+        // msgs enqueued while stats were enabled carry their enqueue time
+        uint64_t enqueueNs = msg->mEnqueueTimeNs;
+        uint64_t startNs = 0;
+        const void* type = nullptr;
+        if (0 != enqueueNs) {
+            type = *reinterpret_cast<const void* const*>(msg);
+            startNs = getMonotonicNs();
+        }
+
+        msg->log();
+        // there is where each individual msg handling is invoked
+        msg->proc();
+
+        if (0 != enqueueNs) {
+            stats.onProc(type, enqueueNs, startNs, getMonotonicNs());
+        }
+
+        msg->destroy();
+    }
+}
+
+// A msg parked by MTRunnable until it is due, ties are broken by arrival
+struct LocDelayedMsg {
+    uint64_t mDueTimeNs;
+    uint64_t mSeq;
+    LocMsg* mMsg;
+    // std heap functions build a max heap, so the earliest due compares greatest
+    inline bool operator<(const LocDelayedMsg& other) const {
+        return (mDueTimeNs != other.mDueTimeNs) ? (mDueTimeNs > other.mDueTimeNs) :
+                                                  (mSeq > other.mSeq);
+    }
+};
+
 class MTRunnable : public LocRunnable {
     const void* mQ;
+    std::shared_ptr<MsgTaskStats> mStats;
+    std::vector<void*> mBatch;
+    std::vector<LocDelayedMsg> mDelayed;
+    uint64_t mDelayedSeq;
+    void procDueMsgs();
 public:
-    inline MTRunnable(const void* q) : mQ(q) {}
+    inline MTRunnable(const void* q, const std::shared_ptr<MsgTaskStats>& stats,
+                      uint32_t maxBatch) :
+        mQ(q), mStats(stats), mBatch((maxBatch > 0) ? maxBatch : 1), mDelayedSeq(0) {
+        mDelayed.reserve(16);
+    }
     virtual ~MTRunnable();
     // Overrides of LocRunnable methods
     // This method will be repeated called until it returns false; or
@@ -56,18 +321,164 @@ public:
     virtual void interrupt() override;
 };
 
-static void LocMsgDestroy(void* msg) {
-    delete (LocMsg*)msg;
+static const void* LocMsgQInit(msg_q_engine_type engine, uint32_t ringSize) {
+    void* q = NULL;
+    if (eMSG_Q_SUCCESS != msg_q_init_engine(&q, engine, ringSize)) {
+        LOC_LOGE("%s: failed to init msg q with engine %d, fall back to default",
+                 __func__, engine);
+        q = (void*)msg_q_init2();
+    }
+    return q;
 }
 
-MsgTask::MsgTask(const char* threadName) :
-    mQ(msg_q_init2()), mThread() {
-    mThread.start(threadName, std::make_shared<MTRunnable>(mQ));
+MsgTask::MsgTask(const char* threadName, msg_q_engine_type engine, uint32_t ringSize,
+                 uint32_t maxBatch, const LocThreadAttr& threadAttr) :
+    mQ(LocMsgQInit(engine, ringSize)), mCoalescing(false),
+    mStats(std::make_shared<MsgTaskStats>()), mThread(),
+    mPool(nullptr), mScheduled(false), mRunning(0), mBatch() {
+    mThread.start(threadName, std::make_shared<MTRunnable>(mQ, mStats, maxBatch), threadAttr);
+}
+
+MsgTask::MsgTask(const LocStrandPool& pool, msg_q_engine_type engine, uint32_t ringSize,
+                 uint32_t maxBatch) :
+    mQ(LocMsgQInit(engine, ringSize)), mCoalescing(false),
+    mStats(std::make_shared<MsgTaskStats>()), mThread(),
+    mPool(&pool), mScheduled(false), mRunning(0),
+    mBatch((maxBatch > 0) ? maxBatch : 1) {
+}
+
+MsgTask::~MsgTask() {
+    if (nullptr != mPool) {
+        // claiming mScheduled for good keeps workers off this strand
+        while (mScheduled.exchange(true)) {
+            usleep(1000);
+        }
+        // a worker may be past letting go of mScheduled but not yet done
+        while (mRunning.load() > 0) {
+            usleep(1000);
+        }
+        msg_q_flush((void*)mQ);
+        msg_q_destroy((void**)&mQ);
+    }
+}
+
+static thread_local const MsgTask* sCurrentStrand = nullptr;
+
+const MsgTask* MsgTask::getCurrentStrand() {
+    return sCurrentStrand;
+}
+
+// run by a LocStrandPool worker, which got this strand off the run queue
+void MsgTask::runStrand() const {
+    // counted while still holding mScheduled, so the destructor, which can
+    // only claim mScheduled after it is let go below, waits for this run
+    mRunning.fetch_add(1);
+    uint32_t count = 0;
+    if (eMSG_Q_SUCCESS == msg_q_rmv_batch((void*)mQ, mBatch.data(), mBatch.size(), &count)) {
+        sCurrentStrand = this;
+        LocMsgProcBatch(mBatch.data(), count, *mStats);
+        sCurrentStrand = nullptr;
+    }
+
+    // a msg sent after the flag is cleared schedules the strand itself, one
+    // sent before is seen here
+    mScheduled.store(false);
+    uint32_t depth = 0;
+    if (eMSG_Q_SUCCESS == msg_q_get_depth((void*)mQ, &depth) && depth > 0 &&
+        !mScheduled.exchange(true)) {
+        mPool->schedule(this);
+    }
+    // last touch of this strand, which may be destroyed right after
+    mRunning.fetch_sub(1);
+}
+
+void MsgTask::enableStats(uint32_t logIntervalSec) {
+    mStats->enable(logIntervalSec);
+}
+
+void MsgTask::disableStats() {
+    mStats->disable();
+}
+
+bool MsgTask::statsEnabled() const {
+    return mStats->isEnabled();
+}
+
+void MsgTask::dumpStats(std::string& out) const {
+    uint32_t depth = 0;
+    msg_q_get_depth((void*)mQ, &depth);
+    mStats->dump(out, depth);
+
+    char buf[128];
+    uint64_t dropped = 0;
+    uint64_t merged = 0;
+    for (uint32_t lane = 0;
+         eMSG_Q_SUCCESS == msg_q_get_lane_stats((void*)mQ, lane, &depth, &dropped, &merged);
+         lane++) {
+        snprintf(buf, sizeof(buf), " lane %u: depth %u, dropped %" PRIu64 ", merged %" PRIu64 "\n",
+                 lane, depth, dropped, merged);
+        out += buf;
+    }
+
+    // the msg pools are shared by all the MsgTasks of the process
+    out += "msg pools:\n";
+    LocMsgPoolBase::dump(out);
+}
+
+bool MsgTask::enablePriorityLanes(const uint32_t* maxDepths, uint32_t starvationLimit) {
+    msq_q_err_type result = msg_q_set_lanes((void*)mQ, LOC_MSG_LANE_MAX,
+                                            maxDepths, starvationLimit);
+    if (eMSG_Q_SUCCESS != result) {
+        LOC_LOGE("%s: fail enabling priority lanes: %s", __func__,
+                 loc_get_msg_q_status(result));
+    }
+    return (eMSG_Q_SUCCESS == result);
 }
 
 void MsgTask::sendMsg(const LocMsg* msg) const {
+    enqueue(msg, 0);
+}
+
+void MsgTask::sendMsgDelayed(const LocMsg* msg, uint32_t delayMs) const {
+    sendMsgAt(msg, getMonotonicNs() + (uint64_t)delayMs * 1000000ULL);
+}
+
+void MsgTask::sendMsgAt(const LocMsg* msg, uint64_t deadlineNs) const {
+    if (nullptr != mPool && nullptr != msg) {
+        // workers have no idle wait to hook the deadline into
+        const MsgTask* strand = this;
+        mPool->getTimerTask().sendMsgAt(LocCallMsg::create([strand, msg] {
+            strand->sendMsg(msg);
+        }), deadlineNs);
+        return;
+    }
+    // 0 means not delayed
+    enqueue(msg, (deadlineNs > 0) ? deadlineNs : 1);
+}
+
+uint64_t MsgTask::getMonotonicTimeNs() {
+    return getMonotonicNs();
+}
+
+void MsgTask::enqueue(const LocMsg* msg, uint64_t dueTimeNs) const {
     if (msg && this) {
-        msg_q_snd((void*)mQ, (void*)msg, LocMsgDestroy);
+        msg->mDueTimeNs = dueTimeNs;
+        msg->mQNode.lane = msg->getLane();
+        msg->mQNode.coalesce_key = (mCoalescing && 0 == dueTimeNs) ? msg->getCoalesceKey() : 0;
+        if (mStats->isEnabled()) {
+            mStats->onEnqueue(msg);
+            msg_q_snd_node((void*)mQ, &msg->mQNode);
+            // msg may already be gone here
+            uint32_t depth = 0;
+            if (eMSG_Q_SUCCESS == msg_q_get_depth((void*)mQ, &depth)) {
+                mStats->onDepth(depth);
+            }
+        } else {
+            msg_q_snd_node((void*)mQ, &msg->mQNode);
+        }
+        if (nullptr != mPool && !mScheduled.exchange(true)) {
+            mPool->schedule(this);
+        }
     } else {
         LOC_LOGE("%s: msg is %p and this is %p",
                  __func__, msg, this);
@@ -95,24 +506,70 @@ void MTRunnable::prerun() {
 }
 
 bool MTRunnable::run() {
-    LocMsg* msg;
-    msq_q_err_type result = msg_q_rcv((void*)mQ, (void **)&msg);
+    uint32_t count = 0;
+    msq_q_err_type result;
+    if (mDelayed.empty()) {
+        result = msg_q_rcv_batch((void*)mQ, mBatch.data(), mBatch.size(), &count);
+    } else {
+        // sleep no longer than until the earliest parked msg is due
+        struct timespec deadline;
+        deadline.tv_sec = mDelayed.front().mDueTimeNs / 1000000000ULL;
+        deadline.tv_nsec = mDelayed.front().mDueTimeNs % 1000000000ULL;
+        result = msg_q_rcv_batch_timed((void*)mQ, mBatch.data(), mBatch.size(),
+                                       &count, &deadline);
+        if (eMSG_Q_EMPTY == result) {
+            count = 0;
+            result = eMSG_Q_SUCCESS;
+        }
+    }
     if (eMSG_Q_SUCCESS != result) {
         LOC_LOGE("%s:%d] fail receiving msg: %s\n", __func__, __LINE__,
                  loc_get_msg_q_status(result));
         return false;
     }
 
-    msg->log();
-    // there is where each individual msg handling is invoked
-    msg->proc();
+    // park msgs not due yet, in place
+    uint32_t ready = 0;
+    uint64_t nowNs = (count > 0) ? getMonotonicNs() : 0;
+    for (uint32_t i = 0; i < count; i++) {
+        LocMsg* msg = (LocMsg*)mBatch[i];
+        if (msg->mDueTimeNs > nowNs) {
+            mDelayed.push_back({msg->mDueTimeNs, mDelayedSeq++, msg});
+            std::push_heap(mDelayed.begin(), mDelayed.end());
+        } else {
+            mBatch[ready++] = msg;
+        }
+    }
 
-    delete msg;
+    LocMsgProcBatch(mBatch.data(), ready, *mStats);
+
+    if (!mDelayed.empty()) {
+        procDueMsgs();
+    }
 
     return true;
 }
 
+void MTRunnable::procDueMsgs() {
+    uint64_t nowNs = getMonotonicNs();
+    while (!mDelayed.empty() && mDelayed.front().mDueTimeNs <= nowNs) {
+        std::pop_heap(mDelayed.begin(), mDelayed.end());
+        void* msg = mDelayed.back().mMsg;
+        mDelayed.pop_back();
+        LocMsg* delayedMsg = (LocMsg*)msg;
+        delayedMsg->mDueTimeNs = 0;
+        // latency counts from when the msg was due
+        if (0 != delayedMsg->mEnqueueTimeNs) {
+            delayedMsg->mEnqueueTimeNs = nowNs;
+        }
+        LocMsgProcBatch(&msg, 1, *mStats);
+    }
+}
+
 MTRunnable::~MTRunnable() {
+    for (auto& delayed : mDelayed) {
+        delayed.mMsg->destroy();
+    }
     msg_q_flush((void*)mQ);
     msg_q_destroy((void**)&mQ);
 }
@@ -29,26 +29,187 @@
 #ifndef __MSG_TASK__
 #define __MSG_TASK__
 
+#include <cstddef>
+#include <atomic>
 #include <functional>
+#include <memory>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
 #include <LocThread.h>
+#include <LocStrandPool.h>
+#include <LocMsgPool.h>
+#include <msg_q.h>
 
 namespace loc_util {
 
+// Priority lanes of a MsgTask with priority lanes enabled, highest first
+enum LocMsgLane {
+    LOC_MSG_LANE_CONTROL = 0,   // commands, responses, everything else
+    LOC_MSG_LANE_POSITION,      // position reports
+    LOC_MSG_LANE_BULK,          // SV, NMEA, measurement and data reports
+    LOC_MSG_LANE_MAX
+};
+
 struct LocMsg {
-    inline LocMsg() {}
+    // intrusive link used by MsgTask to queue this msg without allocation,
+    // also carries the dealloc policy applied after proc()
+    mutable msg_q_node mQNode;
+    // set by MsgTask when stats are enabled, see MsgTask::enableStats()
+    mutable uint64_t mEnqueueTimeNs;
+    // CLOCK_MONOTONIC time proc() is due, 0 if not delayed; see MsgTask::sendMsgAt()
+    mutable uint64_t mDueTimeNs;
+    inline LocMsg() :
+        mQNode{NULL, this, deleteMsg, 0, 0, 0}, mEnqueueTimeNs(0), mDueTimeNs(0) {}
+    inline LocMsg(void (*dealloc)(void*)) :
+        mQNode{NULL, this, dealloc, 0, 0, 0}, mEnqueueTimeNs(0), mDueTimeNs(0) {}
+    inline LocMsg(const LocMsg& msg) :
+        mQNode{NULL, this, msg.mQNode.dealloc, 0, 0, 0}, mEnqueueTimeNs(0), mDueTimeNs(0) {}
+    inline LocMsg& operator=(const LocMsg&) { return *this; }
     inline virtual ~LocMsg() {}
     virtual void proc() const = 0;
     inline virtual void log() const {}
+    // lane this msg is queued on, if the MsgTask has priority lanes enabled
+    inline virtual LocMsgLane getLane() const { return LOC_MSG_LANE_CONTROL; }
+    // Latest wins coalescing: a msg with a non zero key replaces, in place, a
+    // msg with the same key still queued on its lane, which is then destroyed
+    // without being processed. Only meant for reports that fully supersede
+    // the previous one. Keys must be unique per process, e.g. the address of
+    // a static tag. Only honored once MsgTask::enableCoalescing() is called,
+    // and not supported by eMSG_Q_ENGINE_MPSC_RING.
+    inline virtual uintptr_t getCoalesceKey() const { return 0; }
+    inline void destroy() const {
+        if (NULL != mQNode.dealloc) {
+            mQNode.dealloc((void*)this);
+        }
+    }
+    inline static void deleteMsg(void* msg) { delete (LocMsg*)msg; }
+};
+
+// LocMsg running a callable, whose captures are stored inline when they fit
+// in kCaptureSize. The msg objects themselves are recycled through a bounded
+// free list, so posting a typical lambda costs no heap allocation.
+class LocCallMsg : public LocMsg {
+public:
+    static const size_t kCaptureSize = 64;
+
+    template <typename F>
+    static LocCallMsg* create(F&& callable) {
+        typedef typename std::decay<F>::type Fn;
+        LocCallMsg* msg = new LocCallMsg();
+        Store<Fn, (sizeof(Fn) <= kCaptureSize &&
+                   alignof(Fn) <= alignof(std::max_align_t))>::construct(
+                msg, std::forward<F>(callable));
+        return msg;
+    }
+    inline ~LocCallMsg() { mDestruct(mCapture); }
+    inline virtual void proc() const override { mInvoke(mCapture); }
+
+    LOC_MSG_POOL(LocCallMsg, 32)
+
+private:
+    inline LocCallMsg() : LocMsg(), mInvoke(nullptr), mDestruct(nullptr) {}
+
+    template <typename Fn, bool inlined> struct Store;
+    // captures fit, stored in mCapture
+    template <typename Fn> struct Store<Fn, true> {
+        template <typename F>
+        static void construct(LocCallMsg* msg, F&& callable) {
+            new (msg->mCapture) Fn(std::forward<F>(callable));
+            msg->mInvoke = [] (void* c) { (*static_cast<Fn*>(c))(); };
+            msg->mDestruct = [] (void* c) { static_cast<Fn*>(c)->~Fn(); };
+        }
+    };
+    // captures too large, mCapture holds a pointer to a heap copy
+    template <typename Fn> struct Store<Fn, false> {
+        template <typename F>
+        static void construct(LocCallMsg* msg, F&& callable) {
+            new (msg->mCapture) Fn*(new Fn(std::forward<F>(callable)));
+            msg->mInvoke = [] (void* c) { (**static_cast<Fn**>(c))(); };
+            msg->mDestruct = [] (void* c) { delete *static_cast<Fn**>(c); };
+        }
+    };
+
+    void (*mInvoke)(void* capture);
+    void (*mDestruct)(void* capture);
+    alignas(std::max_align_t) mutable unsigned char mCapture[kCaptureSize];
 };
 
+class MsgTaskStats;
+
 class MsgTask {
     const void* mQ;
+    bool mCoalescing;
+    std::shared_ptr<MsgTaskStats> mStats;
     LocThread mThread;
+    // strand mode only
+    const LocStrandPool* mPool;
+    mutable std::atomic<bool> mScheduled;
+    // workers in runStrand(), which still touches the strand after letting go
+    // of mScheduled; the next worker may be in before the last one is out
+    mutable std::atomic<uint32_t> mRunning;
+    mutable std::vector<void*> mBatch;
+
+    friend class LocStrandWorker;
+    void runStrand() const;
+    void enqueue(const LocMsg* msg, uint64_t dueTimeNs) const;
 public:
-    ~MsgTask() = default;
-    MsgTask(const char* threadName = NULL);
+    ~MsgTask();
+    // maxBatch bounds how many queued msgs the thread takes off the queue at
+    // a time, see msg_q_rcv_batch(); 1 processes msgs strictly one by one.
+    MsgTask(const char* threadName = NULL,
+            msg_q_engine_type engine = eMSG_Q_ENGINE_LINKED_LIST, uint32_t ringSize = 0,
+            uint32_t maxBatch = 1, const LocThreadAttr& threadAttr = LocThreadAttr());
+    // Strand mode: no thread of its own, msgs are processed in order by the
+    // workers of pool, see LocStrandPool. maxBatch is the max number of msgs
+    // processed before the worker moves on to the next strand.
+    MsgTask(const LocStrandPool& pool,
+            msg_q_engine_type engine = eMSG_Q_ENGINE_LINKED_LIST, uint32_t ringSize = 0,
+            uint32_t maxBatch = 1);
+    // The strand whose msg is being processed on the calling thread; nullptr
+    // if there is none, e.g. on the thread of a regular MsgTask. Lets replies
+    // find their way back to the strand the request came from.
+    static const MsgTask* getCurrentStrand();
+    // Switches the queue into priority lane mode, see msg_q_set_lanes().
+    // maxDepths has LOC_MSG_LANE_MAX entries. Only valid before any msg is sent.
+    bool enablePriorityLanes(const uint32_t* maxDepths, uint32_t starvationLimit);
+    // Honors LocMsg::getCoalesceKey() from now on, off by default
+    inline void enableCoalescing() { mCoalescing = true; }
+    // Starts recording queue depth high water mark, enqueue to proc() latency
+    // and proc() time histograms per LocMsg type. A summary is logged every
+    // logIntervalSec while msgs flow, 0 for no periodic log.
+    void enableStats(uint32_t logIntervalSec);
+    void disableStats();
+    bool statsEnabled() const;
+    // Appends a human readable dump of the recorded stats to out, followed
+    // by the process wide stats of the LocMsgPools
+    void dumpStats(std::string& out) const;
     void sendMsg(const LocMsg* msg) const;
     void sendMsg(const std::function<void()> runnable) const;
+    // callable may be move only; see LocCallMsg
+    template <typename F, typename = typename std::enable_if<
+            !std::is_convertible<F, const LocMsg*>::value>::type>
+    inline void sendMsg(F&& callable) const {
+        sendMsg(LocCallMsg::create(std::forward<F>(callable)));
+    }
+    // Delayed msgs: proc() runs on this MsgTask no earlier than delayMs from
+    // now, or than deadlineNs on CLOCK_MONOTONIC. The msg is queued right away
+    // and parked by the MsgTask thread until due, which then sleeps on the
+    // queue only until the earliest due msg, so there is no timer thread and
+    // no allocation involved. Delayed msgs are not coalesced, and time spent
+    // in suspend does not count; use LocTimer if the delay has to span it.
+    // In strand mode the msg waits on the timer thread of the pool instead.
+    void sendMsgDelayed(const LocMsg* msg, uint32_t delayMs) const;
+    void sendMsgAt(const LocMsg* msg, uint64_t deadlineNs) const;
+    template <typename F, typename = typename std::enable_if<
+            !std::is_convertible<F, const LocMsg*>::value>::type>
+    inline void sendMsgDelayed(F&& callable, uint32_t delayMs) const {
+        sendMsgDelayed(LocCallMsg::create(std::forward<F>(callable)), delayMs);
+    }
+    // current CLOCK_MONOTONIC time, the clock of sendMsgAt() deadlines
+    static uint64_t getMonotonicTimeNs();
 };
 
 } //
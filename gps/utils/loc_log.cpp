@@ -43,6 +43,7 @@
 #include <algorithm>
 #include <string>
 #include <cctype>
+#include <mutex>
 #define  BUFFER_SIZE  120
 #define  LOG_TAG_LEVEL_CONF_FILE_PATH "/data/vendor/location/gps.prop"
 
@@ -67,6 +68,9 @@ loc_logger_s_type loc_logger;
 /* tag base logging control map*/
 static std::unordered_map<std::string, uint8_t> tag_level_map;
 static bool tag_map_inited = false;
+static unsigned long tag_map_debug_level = 0;
+static std::mutex tag_map_lock;
+uint32_t loc_log_level_gen = 0;
 
 /* returns the least signification bit that is set in the mask
    Param
@@ -224,22 +228,43 @@ void log_buffer_insert(char *str, unsigned long buf_size __unused, int level)
 {
     timespec tv;
     clock_gettime(CLOCK_BOOTTIME, &tv);
-    uint64_t elapsedTime = (uint64_t)tv.tv_sec + (uint64_t)tv.tv_nsec/1000000000;
-    string ss = str;
-    loc_util::LogBuffer::getInstance()->append(ss, level, elapsedTime);
+    uint64_t elapsedTime = (uint64_t)tv.tv_sec * 1000000000ULL + (uint64_t)tv.tv_nsec;
+    loc_util::LogBuffer::getInstance()->append(str, strlen(str), level, elapsedTime);
 }
 
-void log_tag_level_map_init()
+/*===========================================================================
+
+FUNCTION log_buffer_insert_binary
+
+DESCRIPTION
+   Insert a binary log sentence with specific level to the log buffer, to be
+   formatted when the log buffer is dumped; see LocBinLog.h.
+
+RETURN VALUE
+   N/A
+
+===========================================================================*/
+void loc_util::log_buffer_insert_binary(int level, const char* tag, const char* format,
+                                        const char* args, uint32_t len)
 {
-    if (tag_map_inited) {
-        return;
-    }
+    static thread_local int32_t tid = syscall(SYS_gettid);
+    timespec tv;
+    clock_gettime(CLOCK_BOOTTIME, &tv);
+    uint64_t elapsedTime = (uint64_t)tv.tv_sec * 1000000000ULL + (uint64_t)tv.tv_nsec;
+    loc_util::LogBuffer::getInstance()->appendBinary(format, args, len, level, elapsedTime,
+                                                      tag, tid);
+}
 
+void log_tag_level_map_init()
+{
+    std::unordered_map<std::string, uint8_t> levels;
     std::string filename = LOG_TAG_LEVEL_CONF_FILE_PATH;
 
     std::ifstream s(filename);
     if (!s.is_open()) {
-        ALOGE("cannot open file:%s", LOG_TAG_LEVEL_CONF_FILE_PATH);
+        if (!tag_map_inited) {
+            ALOGE("cannot open file:%s", LOG_TAG_LEVEL_CONF_FILE_PATH);
+        }
     } else {
         std::string line;
         while (std::getline(s, line)) {
@@ -255,28 +280,66 @@ void log_tag_level_map_init()
                 ALOGE("wrong format in gps.prop");
                 continue;
             }
-            tag_level_map[tag] = (uint8_t)std::stoul(level);
+            levels[tag] = (uint8_t)std::stoul(level);
         }
     }
-    tag_map_inited = true;
+
+    // this runs on every read of gps.conf, only make the modules re-read their
+    // cached levels when something has changed
+    std::lock_guard<std::mutex> guard(tag_map_lock);
+    if (!tag_map_inited || levels != tag_level_map ||
+            tag_map_debug_level != loc_logger.DEBUG_LEVEL) {
+        tag_level_map.swap(levels);
+        tag_map_debug_level = loc_logger.DEBUG_LEVEL;
+        tag_map_inited = true;
+        __atomic_add_fetch(&loc_log_level_gen, 1, __ATOMIC_RELEASE);
+    }
 }
 
 int get_tag_log_level(const char* tag)
 {
+    std::lock_guard<std::mutex> guard(tag_map_lock);
     if (!tag_map_inited) {
         return -1;
     }
 
     // in case LOG_TAG isn't defined in a source file, use the global log level
     if (tag == NULL) {
-        return loc_logger.DEBUG_LEVEL;
+        return tag_map_debug_level;
     }
     int log_level;
     auto search = tag_level_map.find(std::string(tag));
     if (tag_level_map.end() != search) {
         log_level = search->second;
     } else {
-        log_level = loc_logger.DEBUG_LEVEL;
+        log_level = tag_map_debug_level;
     }
     return log_level;
 }
+
+/*===========================================================================
+
+FUNCTION loc_log_level_refresh
+
+DESCRIPTION
+   Re-read the debug level of a tag into the LOCAL_LOG_LEVEL cache of a module,
+   see IF_LOC_LOG in log_util.h. Levels out of 0 - 5, including the 0xff of an
+   unset DEBUG_LEVEL, are cached as 0.
+
+RETURN VALUE
+   the new cache word, generation << 32 | level
+
+===========================================================================*/
+uint64_t loc_log_level_refresh(uint64_t* cache, const char* tag)
+{
+    // the map is updated before the generation is bumped, so a level read after
+    // the generation is at least as new as it
+    uint32_t gen = __atomic_load_n(&loc_log_level_gen, __ATOMIC_ACQUIRE);
+    int level = get_tag_log_level(tag);
+    if (level < 0 || level > 5) {
+        level = 0;
+    }
+    uint64_t cached = ((uint64_t)gen << 32) | (uint32_t)level;
+    __atomic_store_n(cache, cached, __ATOMIC_RELAXED);
+    return cached;
+}
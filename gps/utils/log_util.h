@@ -31,6 +31,7 @@
 #define __LOG_UTIL_H__
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <loc_pla.h>
 #if defined (USE_ANDROID_LOGGING) || defined (ANDROID)
 // Android and LE targets with logcat support
@@ -96,6 +97,7 @@ typedef struct loc_logger_s
   unsigned long  DEBUG_LEVEL;
   unsigned long  TIMESTAMP;
   bool           LOG_BUFFER_ENABLE;
+  bool           LOG_BUFFER_BINARY;
 } loc_logger_s_type;
 
 
@@ -156,11 +158,17 @@ inline void loc_logger_init(unsigned long debug, unsigned long timestamp)
     loc_logger.TIMESTAMP = timestamp;
 }
 
-inline void log_buffer_init(bool enabled) {
-    loc_logger.LOG_BUFFER_ENABLE = enabled;
+// mode is LOG_BUFFER_ENABLED of gps.conf: 0 off, 1 lines formatted as they
+// are logged, 2 lines recorded in binary and formatted when dumped
+inline void log_buffer_init(unsigned long mode) {
+    loc_logger.LOG_BUFFER_ENABLE = (0 != mode);
+    loc_logger.LOG_BUFFER_BINARY = (2 == mode);
 }
 extern void log_tag_level_map_init();
 extern int get_tag_log_level(const char* tag);
+extern uint64_t loc_log_level_refresh(uint64_t* cache, const char* tag);
+/* bumped each time the global or a per tag log level may have changed */
+extern uint32_t loc_log_level_gen;
 extern char* get_timestamp(char* str, unsigned long buf_size);
 extern void log_buffer_insert(char *str, unsigned long buf_size, int level);
 /*=============================================================================
@@ -174,19 +182,36 @@ extern void log_buffer_insert(char *str, unsigned long buf_size, int level);
 #define TOTAL_LOG_LEVELS 5
 #define LOGGING_BUFFER_MAX_LEN 1024
 #define IF_LOG_BUFFER_ENABLE if (loc_logger.LOG_BUFFER_ENABLE)
+#define INSERT_BUFFER_TEXT(level, format, x...)                                               \
+{                                                                                             \
+    char timestr[32];                                                                         \
+    get_timestamp(timestr, sizeof(timestr));                                                  \
+    char log_str[LOGGING_BUFFER_MAX_LEN];                                                     \
+    snprintf(log_str, LOGGING_BUFFER_MAX_LEN, "%s %d %ld %s :" format "\n",                   \
+            timestr, getpid(), syscall(SYS_gettid), LOG_TAG==NULL ? "": LOG_TAG, ##x);        \
+    log_buffer_insert(log_str, sizeof(log_str), level);                                       \
+}
+#ifdef __cplusplus
+// with LOG_BUFFER_ENABLED = 2 lines are recorded in binary, see LocBinLog.h
 #define INSERT_BUFFER(flag, level, format, x...)                                              \
 {                                                                                             \
     IF_LOG_BUFFER_ENABLE {                                                                    \
         if (flag == 0) {                                                                      \
-            char timestr[32];                                                                 \
-            get_timestamp(timestr, sizeof(timestr));                                          \
-            char log_str[LOGGING_BUFFER_MAX_LEN];                                             \
-            snprintf(log_str, LOGGING_BUFFER_MAX_LEN, "%s %d %ld %s :" format "\n",           \
-                    timestr, getpid(), syscall(SYS_gettid), LOG_TAG==NULL ? "": LOG_TAG, ##x);\
-            log_buffer_insert(log_str, sizeof(log_str), level);                               \
+            if (loc_logger.LOG_BUFFER_BINARY) {                                               \
+                loc_util::log_buffer_insert_args(level, LOG_TAG==NULL ? "": LOG_TAG,          \
+                                                 format "\n", ##x);                           \
+            } else INSERT_BUFFER_TEXT(level, format, ##x)                                     \
         }                                                                                     \
     }                                                                                         \
 }
+#else
+#define INSERT_BUFFER(flag, level, format, x...)                                              \
+{                                                                                             \
+    IF_LOG_BUFFER_ENABLE {                                                                    \
+        if (flag == 0) INSERT_BUFFER_TEXT(level, format, ##x)                                 \
+    }                                                                                         \
+}
+#endif
 
 #ifndef DEBUG_DMN_LOC_API
 
@@ -197,20 +222,38 @@ extern void log_buffer_insert(char *str, unsigned long buf_size, int level);
   Android's logging levels*/
 
 
+/* Levels above LOC_LOG_COMPILE_LEVEL are compiled out of a module together with the
+   evaluation of their arguments, whatever the runtime levels below say. A module may
+   define it in its cflags; the GNSS modules define it to 3, which drops LOC_LOGD and
+   LOC_LOGV, in all but debuggable builds. */
+#ifndef LOC_LOG_COMPILE_LEVEL
+#define LOC_LOG_COMPILE_LEVEL 5
+#endif
+
 /* Tag based logging control MACROS */
 /* The logic is like this:
  * 1, LOCAL_LOG_LEVEL is defined as a static variable in log_util.h,
  *    then all source files which includes log_util.h will have its own LOCAL_LOG_LEVEL variable;
+ *    it caches, in one atomic word, the debug level of LOG_TAG with the loc_log_level_gen
+ *    it was read at;
  * 2, For each source file,
- *    2.1, First time when LOC_LOG* is invoked(its LOCAL_LOG_LEVEL == -1),
+ *    2.1, When LOC_LOG* is invoked and the cached generation is not loc_log_level_gen,
  *         Set the tag based log level according to the <tag, level> map;
  *         If this tag isn't found in map, set local debug level as global loc_logger.DEBUG_LEVEL;
- *    2.2, If not the first time, use its LOCAL_LOG_LEVEL as the debug level of this tag.
+ *    2.2, Otherwise, use the cached level as the debug level of this tag.
+ * 3, loc_log_level_gen starts at 0 and is bumped each time gps.conf is read and the global
+ *    level or the map has changed, so both can be changed at runtime by a gps.conf reload.
 */
-static int LOCAL_LOG_LEVEL = -1;
+static uint64_t LOCAL_LOG_LEVEL = 0;
+static inline int loc_log_level_cached(uint64_t* cache, const char* tag) {
+    uint64_t cached = __atomic_load_n(cache, __ATOMIC_RELAXED);
+    if ((uint32_t)(cached >> 32) != __atomic_load_n(&loc_log_level_gen, __ATOMIC_RELAXED)) {
+        cached = loc_log_level_refresh(cache, tag);
+    }
+    return (int)(uint32_t)cached;
+}
 #define IF_LOC_LOG(x) \
-    if (((LOCAL_LOG_LEVEL == -1 && (LOCAL_LOG_LEVEL = get_tag_log_level(LOG_TAG)) >= x) ||\
-            LOCAL_LOG_LEVEL >= x) && LOCAL_LOG_LEVEL <= 5)
+    if ((x) <= LOC_LOG_COMPILE_LEVEL && loc_log_level_cached(&LOCAL_LOG_LEVEL, LOG_TAG) >= (x))
 
 #define IF_LOC_LOGE IF_LOC_LOG(1)
 #define IF_LOC_LOGW IF_LOC_LOG(2)
@@ -286,6 +329,7 @@ static int LOCAL_LOG_LEVEL = -1;
 
 #ifdef __cplusplus
 }
+#include <LocBinLog.h>
 #endif
 
 #endif // __LOG_UTIL_H__
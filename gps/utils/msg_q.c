@@ -29,59 +29,673 @@
 // Uncomment to log verbose logs
 #define LOG_NDEBUG 1
 #define LOG_TAG "LocSvc_utils_q"
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 #include <loc_pla.h>
 #include <log_util.h>
-#include "linked_list.h"
 #include "msg_q.h"
 
+typedef struct msg_q_ring_slot {
+   _Atomic uint32_t seq;            /* Slot sequence, tells who owns the slot */
+   void* msg_obj;
+   void (*dealloc)(void*);
+} msg_q_ring_slot;
+
+typedef struct msg_q_lane {
+   msg_q_node* head;                /* Oldest queued node of this lane */
+   msg_q_node* tail;                /* Newest queued node of this lane */
+   uint32_t depth;                  /* Number of queued nodes */
+   uint32_t max_depth;              /* Oldest node is dropped beyond this; 0 for unbounded */
+   uint32_t skipped;                /* Dequeues served by other lanes while not empty */
+   uint64_t dropped;                /* Nodes dropped for exceeding max_depth */
+   uint64_t merged;                 /* Nodes replaced by a node with the same coalesce_key */
+} msg_q_lane;
+
 typedef struct msg_q {
-   void* msg_list;                  /* Linked list to store information */
+   msg_q_engine_type engine;        /* Engine backing this message queue */
+   /* eMSG_Q_ENGINE_LINKED_LIST */
+   msg_q_lane lanes[MSG_Q_MAX_LANES]; /* Lane 0 has the highest priority */
+   uint32_t num_lanes;              /* Number of lanes in use, 1 by default */
+   uint32_t starvation_limit;       /* Max dequeues a non empty lane can be skipped */
+   uint32_t pending;                /* Number of queued nodes in all lanes */
    pthread_cond_t  list_cond;       /* Condition variable for waiting on msg queue */
    pthread_mutex_t list_mutex;      /* Mutex for exclusive access to message queue */
    int unblocked;                   /* Has this message queue been unblocked? */
+   /* eMSG_Q_ENGINE_MPSC_RING */
+   msg_q_ring_slot* ring;           /* Ring slots, power of 2 sized */
+   uint32_t ring_mask;              /* Number of slots - 1 */
+   _Atomic uint32_t ring_head;      /* Next slot to be claimed by a producer */
+   _Atomic uint32_t ring_tail;      /* Next slot to be consumed, written by consumer only */
+   _Atomic int32_t ring_futex;      /* Futex word the consumer parks on */
+   _Atomic int ring_parked;         /* Is the consumer parked on ring_futex? */
+   _Atomic int ring_unblocked;      /* Has this message queue been unblocked? */
+   msg_q_node* overflow_head;       /* Messages that found the ring full, under list_mutex */
+   msg_q_node* overflow_tail;
+   _Atomic uint32_t overflow_depth; /* Producers skip the ring while not 0 */
 } msg_q;
 
 /*===========================================================================
-FUNCTION    convert_linked_list_err_type
+FUNCTION    msg_q_list_append
 
 DESCRIPTION
-   Converts from one set of enum values to another.
+   Appends a node to the tail of its lane. If the node has a coalesce_key and
+   a node with the same key is still queued in the lane, the node takes its
+   place instead, and the superseded node is returned to the caller to be
+   released. Otherwise, if the lane is over its max_depth, the oldest node of
+   the lane is taken off and returned to the caller to be released.
+   list_mutex must be held.
+
+RETURN VALUE
+   dropped or superseded node; NULL if none
+
+===========================================================================*/
+static msg_q_node* msg_q_list_append(msg_q* p_msg_q, msg_q_node* node, int* merged)
+{
+   msg_q_node* dropped = NULL;
+   uint32_t lane_idx = node->lane < p_msg_q->num_lanes ? node->lane : p_msg_q->num_lanes - 1;
+   msg_q_lane* lane = &p_msg_q->lanes[lane_idx];
+
+   *merged = 0;
+   if( node->coalesce_key != 0 )
+   {
+      msg_q_node* prev = NULL;
+      msg_q_node* cur = lane->head;
+      for( ; cur != NULL; prev = cur, cur = cur->next )
+      {
+         if( cur->coalesce_key == node->coalesce_key )
+         {
+            node->next = cur->next;
+            if( prev != NULL )
+            {
+               prev->next = node;
+            }
+            else
+            {
+               lane->head = node;
+            }
+            if( lane->tail == cur )
+            {
+               lane->tail = node;
+            }
+            cur->next = NULL;
+            lane->merged++;
+            *merged = 1;
+            return cur;
+         }
+      }
+   }
+
+   node->next = NULL;
+   if( lane->tail != NULL )
+   {
+      lane->tail->next = node;
+   }
+   else
+   {
+      lane->head = node;
+   }
+   lane->tail = node;
+   lane->depth++;
+   p_msg_q->pending++;
+
+   if( lane->max_depth != 0 && lane->depth > lane->max_depth )
+   {
+      dropped = lane->head;
+      lane->head = dropped->next;
+      dropped->next = NULL;
+      lane->depth--;
+      lane->dropped++;
+      p_msg_q->pending--;
+   }
+
+   return dropped;
+}
+
+/*===========================================================================
+FUNCTION    msg_q_list_pick_lane
+
+DESCRIPTION
+   Picks the lane to dequeue from: the highest priority non empty lane,
+   unless a lower priority lane has been skipped starvation_limit times in
+   a row, in which case that lane is served once. list_mutex must be held.
+
+RETURN VALUE
+   lane to dequeue from; NULL if all lanes are empty
+
+===========================================================================*/
+static msg_q_lane* msg_q_list_pick_lane(msg_q* p_msg_q)
+{
+   msg_q_lane* picked = NULL;
+   uint32_t i;
+
+   if( p_msg_q->pending == 0 )
+   {
+      return NULL;
+   }
+
+   for( i = 0; i < p_msg_q->num_lanes; i++ )
+   {
+      msg_q_lane* lane = &p_msg_q->lanes[i];
+      if( lane->head == NULL )
+      {
+         continue;
+      }
+      if( picked == NULL )
+      {
+         picked = lane;
+      }
+      else if( p_msg_q->starvation_limit != 0 &&
+               lane->skipped >= p_msg_q->starvation_limit )
+      {
+         picked = lane;
+         break;
+      }
+   }
 
-   linked_list_val: Value to convert to msg_q_enum_type
+   for( i = 0; i < p_msg_q->num_lanes; i++ )
+   {
+      msg_q_lane* lane = &p_msg_q->lanes[i];
+      if( lane == picked )
+      {
+         lane->skipped = 0;
+      }
+      else if( lane->head != NULL )
+      {
+         lane->skipped++;
+      }
+   }
 
-DEPENDENCIES
-   N/A
+   return picked;
+}
+
+/*===========================================================================
+FUNCTION    msg_q_list_remove
+
+DESCRIPTION
+   Removes the next node to be served, see msg_q_list_pick_lane.
+   list_mutex must be held.
 
 RETURN VALUE
-   Corresponding linked_list_enum_type in msg_q_enum_type
+   next node; NULL if the list is empty
 
-SIDE EFFECTS
-   N/A
+===========================================================================*/
+static msg_q_node* msg_q_list_remove(msg_q* p_msg_q)
+{
+   msg_q_node* node = NULL;
+   msg_q_lane* lane = msg_q_list_pick_lane(p_msg_q);
+   if( lane != NULL )
+   {
+      node = lane->head;
+      lane->head = node->next;
+      if( lane->head == NULL )
+      {
+         lane->tail = NULL;
+      }
+      lane->depth--;
+      p_msg_q->pending--;
+      node->next = NULL;
+   }
+   return node;
+}
+
+/*===========================================================================
+FUNCTION    msg_q_node_release
+
+DESCRIPTION
+   Releases a node taken off the list. The message object is deallocated
+   only if dealloc_obj is set, and the node itself is freed only if msg_q
+   allocated it in msg_q_snd. An intrusive node goes away with its message
+   object, so it is not looked at once the object is deallocated.
 
 ===========================================================================*/
-static msq_q_err_type convert_linked_list_err_type(linked_list_err_type linked_list_val)
+static void msg_q_node_release(msg_q_node* node, int dealloc_obj)
 {
-   switch( linked_list_val )
+   int q_alloc = node->q_alloc;
+   if( dealloc_obj && node->dealloc != NULL )
    {
-   case eLINKED_LIST_SUCCESS:
-      return eMSG_Q_SUCCESS;
-   case eLINKED_LIST_INVALID_PARAMETER:
-      return eMSG_Q_INVALID_PARAMETER;
-   case eLINKED_LIST_INVALID_HANDLE:
-      return eMSG_Q_INVALID_HANDLE;
-   case eLINKED_LIST_UNAVAILABLE_RESOURCE:
+      node->dealloc(node->msg_obj);
+   }
+   if( q_alloc )
+   {
+      free(node);
+   }
+}
+
+/*===========================================================================
+FUNCTION    msg_q_list_snd
+
+DESCRIPTION
+   Queues a node on a eMSG_Q_ENGINE_LINKED_LIST queue and wakes the receiver.
+
+RETURN VALUE
+   Look at error codes above.
+
+===========================================================================*/
+static msq_q_err_type msg_q_list_snd(msg_q* p_msg_q, msg_q_node* node)
+{
+   pthread_mutex_lock(&p_msg_q->list_mutex);
+   LOC_LOGV("%s: Sending message with handle = %p\n", __FUNCTION__, node->msg_obj);
+
+   if( p_msg_q->unblocked )
+   {
+      LOC_LOGE("%s: Message queue has been unblocked.\n", __FUNCTION__);
+      pthread_mutex_unlock(&p_msg_q->list_mutex);
       return eMSG_Q_UNAVAILABLE_RESOURCE;
-   case eLINKED_LIST_INSUFFICIENT_BUFFER:
-      return eMSG_Q_INSUFFICIENT_BUFFER;
-   case eLINKED_LIST_EMPTY:
-      return eMSG_Q_EMPTY;
+   }
 
-   case eLINKED_LIST_FAILURE_GENERAL:
-   default:
-      return eMSG_Q_FAILURE_GENERAL;
+   int was_empty = (p_msg_q->pending == 0);
+   int merged = 0;
+   msg_q_node* dropped = msg_q_list_append(p_msg_q, node, &merged);
+
+   /* Show data is in the message queue. The single receiver only ever waits
+      on an empty queue, so there is no one to wake if it was not empty. */
+   if( was_empty )
+   {
+      pthread_cond_signal(&p_msg_q->list_cond);
+   }
+
+   pthread_mutex_unlock(&p_msg_q->list_mutex);
+
+   if( dropped != NULL )
+   {
+      if( merged )
+      {
+         LOC_LOGV("%s: message %p superseded by %p\n", __FUNCTION__,
+                  dropped->msg_obj, node->msg_obj);
+      }
+      else
+      {
+         LOC_LOGW("%s: lane %u is full, dropped message %p\n", __FUNCTION__,
+                  dropped->lane, dropped->msg_obj);
+      }
+      msg_q_node_release(dropped, 1);
+   }
+
+   LOC_LOGV("%s: Finished Sending message with handle = %p\n", __FUNCTION__, node->msg_obj);
+
+   return eMSG_Q_SUCCESS;
+}
+
+/*===========================================================================
+FUNCTION    msg_q_futex_wait / msg_q_futex_wake
+
+DESCRIPTION
+   Thin wrappers of the futex syscall on a process private futex word.
+   timeout is relative, NULL waits forever.
+
+===========================================================================*/
+static void msg_q_futex_wait(_Atomic int32_t* word, int32_t val,
+                             const struct timespec* timeout)
+{
+   syscall(SYS_futex, (int32_t*)word, FUTEX_WAIT_PRIVATE, val, timeout, NULL, 0);
+}
+
+/*===========================================================================
+FUNCTION    msg_q_time_left
+
+DESCRIPTION
+   Time left from now until the CLOCK_MONOTONIC deadline.
+
+RETURN VALUE
+   0 if the deadline has already passed, 1 otherwise.
+
+===========================================================================*/
+static int msg_q_time_left(const struct timespec* deadline, struct timespec* left)
+{
+   struct timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   int64_t ns = (int64_t)(deadline->tv_sec - now.tv_sec) * 1000000000LL +
+                (deadline->tv_nsec - now.tv_nsec);
+   if( ns <= 0 )
+   {
+      return 0;
+   }
+   left->tv_sec = ns / 1000000000LL;
+   left->tv_nsec = ns % 1000000000LL;
+   return 1;
+}
+
+static void msg_q_futex_wake(_Atomic int32_t* word, int count)
+{
+   syscall(SYS_futex, (int32_t*)word, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+/*===========================================================================
+FUNCTION    msg_q_ring_init
+
+DESCRIPTION
+   Allocates and initializes the slots of an eMSG_Q_ENGINE_MPSC_RING queue.
+   Slot i starts with sequence i, which means it is free for the producer
+   that claims position i.
+
+RETURN VALUE
+   0 if success; -1 if failure
+
+===========================================================================*/
+static int msg_q_ring_init(msg_q* p_msg_q, uint32_t ring_size)
+{
+   uint32_t size = 2;
+   uint32_t i;
+
+   if( ring_size == 0 )
+   {
+      ring_size = MSG_Q_DEFAULT_RING_SIZE;
+   }
+   while( size < ring_size && size < (1u << 30) )
+   {
+      size <<= 1;
+   }
+
+   p_msg_q->ring = (msg_q_ring_slot*)calloc(size, sizeof(msg_q_ring_slot));
+   if( p_msg_q->ring == NULL )
+   {
+      return -1;
+   }
+   if( pthread_mutex_init(&p_msg_q->list_mutex, NULL) != 0 )
+   {
+      free(p_msg_q->ring);
+      p_msg_q->ring = NULL;
+      return -1;
+   }
+
+   for( i = 0; i < size; i++ )
+   {
+      atomic_init(&p_msg_q->ring[i].seq, i);
+   }
+   p_msg_q->ring_mask = size - 1;
+   atomic_init(&p_msg_q->ring_head, 0);
+   atomic_init(&p_msg_q->ring_tail, 0);
+   atomic_init(&p_msg_q->ring_futex, 0);
+   atomic_init(&p_msg_q->ring_parked, 0);
+   atomic_init(&p_msg_q->ring_unblocked, 0);
+   p_msg_q->overflow_head = NULL;
+   p_msg_q->overflow_tail = NULL;
+   atomic_init(&p_msg_q->overflow_depth, 0);
+
+   return 0;
+}
+
+/*===========================================================================
+FUNCTION    msg_q_ring_wake
+
+DESCRIPTION
+   Wakes up the consumer after a message was published, if it has parked
+   itself on ring_futex.
+
+===========================================================================*/
+static void msg_q_ring_wake(msg_q* p_msg_q)
+{
+   /* Pairs with the fence in msg_q_ring_rcv, either we see the consumer
+      parked, or the consumer sees the message we just published. */
+   atomic_thread_fence(memory_order_seq_cst);
+   if( atomic_load_explicit(&p_msg_q->ring_parked, memory_order_relaxed) )
+   {
+      atomic_fetch_add_explicit(&p_msg_q->ring_futex, 1, memory_order_relaxed);
+      msg_q_futex_wake(&p_msg_q->ring_futex, 1);
+   }
+}
+
+/*===========================================================================
+FUNCTION    msg_q_ring_spill
+
+DESCRIPTION
+   Queues a message that found the ring full on the overflow list, which the
+   consumer drains once the ring is empty. node is used if not NULL, else
+   one is allocated. Producers keep spilling until the list is drained, so
+   that the messages of each producer stay in order.
+
+RETURN VALUE
+   Look at error codes above.
+
+===========================================================================*/
+static msq_q_err_type msg_q_ring_spill(msg_q* p_msg_q, void* msg_obj, void (*dealloc)(void*),
+                                       msg_q_node* node)
+{
+   if( node == NULL )
+   {
+      node = (msg_q_node*)malloc(sizeof(msg_q_node));
+      if( node == NULL )
+      {
+         LOC_LOGE("%s: Memory allocation failed\n", __FUNCTION__);
+         return eMSG_Q_FAILURE_GENERAL;
+      }
+      node->q_alloc = 1;
+   }
+   else
+   {
+      node->q_alloc = 0;
+   }
+   node->next = NULL;
+   node->msg_obj = msg_obj;
+   node->dealloc = dealloc;
+
+   pthread_mutex_lock(&p_msg_q->list_mutex);
+   if( p_msg_q->overflow_tail != NULL )
+   {
+      p_msg_q->overflow_tail->next = node;
+   }
+   else
+   {
+      p_msg_q->overflow_head = node;
+   }
+   p_msg_q->overflow_tail = node;
+   atomic_fetch_add_explicit(&p_msg_q->overflow_depth, 1, memory_order_relaxed);
+   pthread_mutex_unlock(&p_msg_q->list_mutex);
+
+   msg_q_ring_wake(p_msg_q);
+
+   return eMSG_Q_SUCCESS;
+}
+
+/*===========================================================================
+FUNCTION    msg_q_ring_push
+
+DESCRIPTION
+   Lock-free enqueue from any producer thread. A slot is claimed by a CAS on
+   ring_head and published by a release store of its sequence. The consumer
+   is woken up only if it has parked itself on ring_futex. A producer never
+   waits for the ring to have room: the consumer itself may be the one
+   posting, so a full ring spills into the overflow list instead, see
+   msg_q_ring_spill. node, if not NULL, is used for the overflow list.
+
+RETURN VALUE
+   Look at error codes above.
+
+===========================================================================*/
+static msq_q_err_type msg_q_ring_push(msg_q* p_msg_q, void* msg_obj, void (*dealloc)(void*),
+                                      msg_q_node* node)
+{
+   msg_q_ring_slot* slot;
+   uint32_t pos = atomic_load_explicit(&p_msg_q->ring_head, memory_order_relaxed);
+
+   for( ;; )
+   {
+      if( atomic_load_explicit(&p_msg_q->ring_unblocked, memory_order_relaxed) )
+      {
+         LOC_LOGE("%s: Message queue has been unblocked.\n", __FUNCTION__);
+         return eMSG_Q_UNAVAILABLE_RESOURCE;
+      }
+
+      if( atomic_load_explicit(&p_msg_q->overflow_depth, memory_order_relaxed) != 0 )
+      {
+         return msg_q_ring_spill(p_msg_q, msg_obj, dealloc, node);
+      }
+
+      slot = &p_msg_q->ring[pos & p_msg_q->ring_mask];
+      int32_t diff = (int32_t)(atomic_load_explicit(&slot->seq, memory_order_acquire) - pos);
+
+      if( diff == 0 )
+      {
+         if( atomic_compare_exchange_weak_explicit(&p_msg_q->ring_head, &pos, pos + 1,
+                                                   memory_order_relaxed,
+                                                   memory_order_relaxed) )
+         {
+            break;
+         }
+      }
+      else if( diff < 0 )
+      {
+         /* Ring is full */
+         return msg_q_ring_spill(p_msg_q, msg_obj, dealloc, node);
+      }
+      else
+      {
+         /* Another producer claimed this slot first */
+         pos = atomic_load_explicit(&p_msg_q->ring_head, memory_order_relaxed);
+      }
+   }
+
+   slot->msg_obj = msg_obj;
+   slot->dealloc = dealloc;
+   atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+
+   msg_q_ring_wake(p_msg_q);
+
+   return eMSG_Q_SUCCESS;
+}
+
+/*===========================================================================
+FUNCTION    msg_q_ring_pop
+
+DESCRIPTION
+   Non blocking dequeue, consumer thread only. The overflow list is only
+   drained once the ring is empty, its messages having been queued after
+   those in the ring.
+
+RETURN VALUE
+   1 if a message was dequeued; 0 if the ring and the overflow list are empty
+
+===========================================================================*/
+static int msg_q_ring_pop(msg_q* p_msg_q, void** msg_obj, void (**dealloc)(void*))
+{
+   uint32_t pos = atomic_load_explicit(&p_msg_q->ring_tail, memory_order_relaxed);
+   msg_q_ring_slot* slot = &p_msg_q->ring[pos & p_msg_q->ring_mask];
+
+   if( atomic_load_explicit(&slot->seq, memory_order_acquire) != pos + 1 )
+   {
+      msg_q_node* node = NULL;
+      if( atomic_load_explicit(&p_msg_q->overflow_depth, memory_order_relaxed) == 0 )
+      {
+         return 0;
+      }
+      pthread_mutex_lock(&p_msg_q->list_mutex);
+      node = p_msg_q->overflow_head;
+      if( node != NULL )
+      {
+         p_msg_q->overflow_head = node->next;
+         if( p_msg_q->overflow_head == NULL )
+         {
+            p_msg_q->overflow_tail = NULL;
+         }
+         node->next = NULL;
+         atomic_fetch_sub_explicit(&p_msg_q->overflow_depth, 1, memory_order_relaxed);
+      }
+      pthread_mutex_unlock(&p_msg_q->list_mutex);
+      if( node == NULL )
+      {
+         return 0;
+      }
+      *msg_obj = node->msg_obj;
+      if( dealloc != NULL )
+      {
+         *dealloc = node->dealloc;
+      }
+      msg_q_node_release(node, 0);
+      return 1;
+   }
+
+   *msg_obj = slot->msg_obj;
+   if( dealloc != NULL )
+   {
+      *dealloc = slot->dealloc;
+   }
+   /* hand the slot over to the producer that will claim it one lap later */
+   atomic_store_explicit(&slot->seq, pos + p_msg_q->ring_mask + 1, memory_order_release);
+   atomic_store_explicit(&p_msg_q->ring_tail, pos + 1, memory_order_relaxed);
+
+   return 1;
+}
+
+/*===========================================================================
+FUNCTION    msg_q_ring_rcv
+
+DESCRIPTION
+   Blocking dequeue, consumer thread only. The consumer parks on ring_futex
+   only after it has announced itself in ring_parked and re-checked the ring.
+   Gives up at deadline (CLOCK_MONOTONIC) unless it is NULL.
+
+RETURN VALUE
+   Look at error codes above; eMSG_Q_EMPTY if the deadline has passed.
+
+===========================================================================*/
+static msq_q_err_type msg_q_ring_rcv(msg_q* p_msg_q, void** msg_obj,
+                                     const struct timespec* deadline)
+{
+   for( ;; )
+   {
+      if( atomic_load_explicit(&p_msg_q->ring_unblocked, memory_order_relaxed) )
+      {
+         LOC_LOGE("%s: Message queue has been unblocked.\n", __FUNCTION__);
+         return eMSG_Q_UNAVAILABLE_RESOURCE;
+      }
+
+      if( msg_q_ring_pop(p_msg_q, msg_obj, NULL) )
+      {
+         return eMSG_Q_SUCCESS;
+      }
+
+      int32_t futex_val = atomic_load_explicit(&p_msg_q->ring_futex, memory_order_relaxed);
+      atomic_store_explicit(&p_msg_q->ring_parked, 1, memory_order_relaxed);
+      atomic_thread_fence(memory_order_seq_cst);
+
+      if( msg_q_ring_pop(p_msg_q, msg_obj, NULL) )
+      {
+         atomic_store_explicit(&p_msg_q->ring_parked, 0, memory_order_relaxed);
+         return eMSG_Q_SUCCESS;
+      }
+
+      struct timespec left;
+      if( deadline != NULL && !msg_q_time_left(deadline, &left) )
+      {
+         atomic_store_explicit(&p_msg_q->ring_parked, 0, memory_order_relaxed);
+         return eMSG_Q_EMPTY;
+      }
+
+      if( !atomic_load_explicit(&p_msg_q->ring_unblocked, memory_order_relaxed) )
+      {
+         msg_q_futex_wait(&p_msg_q->ring_futex, futex_val,
+                          deadline != NULL ? &left : NULL);
+      }
+      atomic_store_explicit(&p_msg_q->ring_parked, 0, memory_order_relaxed);
+   }
+}
+
+/*===========================================================================
+FUNCTION    msg_q_ring_flush
+
+DESCRIPTION
+   Dequeues and deallocates everything in the ring, consumer thread only.
+
+===========================================================================*/
+static void msg_q_ring_flush(msg_q* p_msg_q)
+{
+   void* msg_obj = NULL;
+   void (*dealloc)(void*) = NULL;
+
+   while( msg_q_ring_pop(p_msg_q, &msg_obj, &dealloc) )
+   {
+      if( dealloc != NULL )
+      {
+         dealloc(msg_obj);
+      }
    }
 }
 
@@ -93,6 +707,17 @@ static msq_q_err_type convert_linked_list_err_type(linked_list_err_type linked_l
 
   ===========================================================================*/
 msq_q_err_type msg_q_init(void** msg_q_data)
+{
+   return msg_q_init_engine(msg_q_data, eMSG_Q_ENGINE_LINKED_LIST, 0);
+}
+
+/*===========================================================================
+
+  FUNCTION:   msg_q_init_engine
+
+  ===========================================================================*/
+msq_q_err_type msg_q_init_engine(void** msg_q_data, msg_q_engine_type engine,
+                                 uint32_t ring_size)
 {
    if( msg_q_data == NULL )
    {
@@ -100,6 +725,12 @@ msq_q_err_type msg_q_init(void** msg_q_data)
       return eMSG_Q_INVALID_PARAMETER;
    }
 
+   if( engine != eMSG_Q_ENGINE_LINKED_LIST && engine != eMSG_Q_ENGINE_MPSC_RING )
+   {
+      LOC_LOGE("%s: Invalid engine parameter %d!\n", __FUNCTION__, engine);
+      return eMSG_Q_INVALID_PARAMETER;
+   }
+
    msg_q* tmp_msg_q;
    tmp_msg_q = (msg_q*)calloc(1, sizeof(msg_q));
    if( tmp_msg_q == NULL )
@@ -108,30 +739,45 @@ msq_q_err_type msg_q_init(void** msg_q_data)
       return eMSG_Q_FAILURE_GENERAL;
    }
 
-   if( linked_list_init(&tmp_msg_q->msg_list) != 0 )
+   tmp_msg_q->engine = engine;
+   if( engine == eMSG_Q_ENGINE_MPSC_RING )
    {
-      LOC_LOGE("%s: Unable to initialize storage list!\n", __FUNCTION__);
-      free(tmp_msg_q);
-      return eMSG_Q_FAILURE_GENERAL;
+      if( msg_q_ring_init(tmp_msg_q, ring_size) != 0 )
+      {
+         LOC_LOGE("%s: Unable to allocate message queue ring!\n", __FUNCTION__);
+         free(tmp_msg_q);
+         return eMSG_Q_FAILURE_GENERAL;
+      }
+
+      *msg_q_data = tmp_msg_q;
+
+      return eMSG_Q_SUCCESS;
    }
 
    if( pthread_mutex_init(&tmp_msg_q->list_mutex, NULL) != 0 )
    {
       LOC_LOGE("%s: Unable to initialize list mutex!\n", __FUNCTION__);
-      linked_list_destroy(&tmp_msg_q->msg_list);
       free(tmp_msg_q);
       return eMSG_Q_FAILURE_GENERAL;
    }
 
-   if( pthread_cond_init(&tmp_msg_q->list_cond, NULL) != 0 )
+   /* Timed batch receives pass CLOCK_MONOTONIC deadlines */
+   pthread_condattr_t cond_attr;
+   pthread_condattr_init(&cond_attr);
+   pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+   int cond_rv = pthread_cond_init(&tmp_msg_q->list_cond, &cond_attr);
+   pthread_condattr_destroy(&cond_attr);
+   if( cond_rv != 0 )
    {
       LOC_LOGE("%s: Unable to initialize msg q cond var!\n", __FUNCTION__);
-      linked_list_destroy(&tmp_msg_q->msg_list);
       pthread_mutex_destroy(&tmp_msg_q->list_mutex);
       free(tmp_msg_q);
       return eMSG_Q_FAILURE_GENERAL;
    }
 
+   tmp_msg_q->num_lanes = 1;
+   tmp_msg_q->starvation_limit = 0;
+   tmp_msg_q->pending = 0;
    tmp_msg_q->unblocked = 0;
 
    *msg_q_data = tmp_msg_q;
@@ -168,7 +814,18 @@ msq_q_err_type msg_q_destroy(void** msg_q_data)
 
    msg_q* p_msg_q = (msg_q*)*msg_q_data;
 
-   linked_list_destroy(&p_msg_q->msg_list);
+   if( p_msg_q->engine == eMSG_Q_ENGINE_MPSC_RING )
+   {
+      msg_q_ring_flush(p_msg_q);
+      pthread_mutex_destroy(&p_msg_q->list_mutex);
+      free(p_msg_q->ring);
+      free(*msg_q_data);
+      *msg_q_data = NULL;
+
+      return eMSG_Q_SUCCESS;
+   }
+
+   msg_q_flush(p_msg_q);
    pthread_mutex_destroy(&p_msg_q->list_mutex);
    pthread_cond_destroy(&p_msg_q->list_cond);
 
@@ -187,7 +844,6 @@ msq_q_err_type msg_q_destroy(void** msg_q_data)
   ===========================================================================*/
 msq_q_err_type msg_q_snd(void* msg_q_data, void* msg_obj, void (*dealloc)(void*))
 {
-   msq_q_err_type rv;
    if( msg_q_data == NULL )
    {
       LOC_LOGE("%s: Invalid msg_q_data parameter!\n", __FUNCTION__);
@@ -201,26 +857,61 @@ msq_q_err_type msg_q_snd(void* msg_q_data, void* msg_obj, void (*dealloc)(void*)
 
    msg_q* p_msg_q = (msg_q*)msg_q_data;
 
-   pthread_mutex_lock(&p_msg_q->list_mutex);
-   LOC_LOGV("%s: Sending message with handle = %p\n", __FUNCTION__, msg_obj);
+   if( p_msg_q->engine == eMSG_Q_ENGINE_MPSC_RING )
+   {
+      return msg_q_ring_push(p_msg_q, msg_obj, dealloc, NULL);
+   }
 
-   if( p_msg_q->unblocked )
+   msg_q_node* node = (msg_q_node*)malloc(sizeof(msg_q_node));
+   if( node == NULL )
    {
-      LOC_LOGE("%s: Message queue has been unblocked.\n", __FUNCTION__);
-      pthread_mutex_unlock(&p_msg_q->list_mutex);
-      return eMSG_Q_UNAVAILABLE_RESOURCE;
+      LOC_LOGE("%s: Memory allocation failed\n", __FUNCTION__);
+      return eMSG_Q_FAILURE_GENERAL;
+   }
+   node->next = NULL;
+   node->msg_obj = msg_obj;
+   node->dealloc = dealloc;
+   node->q_alloc = 1;
+   node->lane = 0;
+   node->coalesce_key = 0;
+
+   msq_q_err_type rv = msg_q_list_snd(p_msg_q, node);
+   if( rv != eMSG_Q_SUCCESS )
+   {
+      free(node);
    }
 
-   rv = convert_linked_list_err_type(linked_list_add(p_msg_q->msg_list, msg_obj, dealloc));
+   return rv;
+}
 
-   /* Show data is in the message queue. */
-   pthread_cond_signal(&p_msg_q->list_cond);
+/*===========================================================================
 
-   pthread_mutex_unlock(&p_msg_q->list_mutex);
+  FUNCTION:   msg_q_snd_node
 
-   LOC_LOGV("%s: Finished Sending message with handle = %p\n", __FUNCTION__, msg_obj);
+  ===========================================================================*/
+msq_q_err_type msg_q_snd_node(void* msg_q_data, msg_q_node* node)
+{
+   if( msg_q_data == NULL )
+   {
+      LOC_LOGE("%s: Invalid msg_q_data parameter!\n", __FUNCTION__);
+      return eMSG_Q_INVALID_HANDLE;
+   }
+   if( node == NULL || node->msg_obj == NULL )
+   {
+      LOC_LOGE("%s: Invalid node parameter!\n", __FUNCTION__);
+      return eMSG_Q_INVALID_PARAMETER;
+   }
 
-   return rv;
+   msg_q* p_msg_q = (msg_q*)msg_q_data;
+
+   if( p_msg_q->engine == eMSG_Q_ENGINE_MPSC_RING )
+   {
+      return msg_q_ring_push(p_msg_q, node->msg_obj, node->dealloc, node);
+   }
+
+   node->q_alloc = 0;
+
+   return msg_q_list_snd(p_msg_q, node);
 }
 
 /*===========================================================================
@@ -245,6 +936,11 @@ msq_q_err_type msg_q_rcv(void* msg_q_data, void** msg_obj)
 
    msg_q* p_msg_q = (msg_q*)msg_q_data;
 
+   if( p_msg_q->engine == eMSG_Q_ENGINE_MPSC_RING )
+   {
+      return msg_q_ring_rcv(p_msg_q, msg_obj, NULL);
+   }
+
    pthread_mutex_lock(&p_msg_q->list_mutex);
 
    if( p_msg_q->unblocked )
@@ -255,20 +951,182 @@ msq_q_err_type msg_q_rcv(void* msg_q_data, void** msg_obj)
    }
 
    /* Wait for data in the message queue */
-   while( linked_list_empty(p_msg_q->msg_list) && !p_msg_q->unblocked )
+   while( p_msg_q->pending == 0 && !p_msg_q->unblocked )
    {
       pthread_cond_wait(&p_msg_q->list_cond, &p_msg_q->list_mutex);
    }
 
-   rv = convert_linked_list_err_type(linked_list_remove(p_msg_q->msg_list, msg_obj));
+   msg_q_node* node = msg_q_list_remove(p_msg_q);
 
    pthread_mutex_unlock(&p_msg_q->list_mutex);
 
+   if( node != NULL )
+   {
+      *msg_obj = node->msg_obj;
+      msg_q_node_release(node, 0);
+      rv = eMSG_Q_SUCCESS;
+   }
+   else
+   {
+      rv = eMSG_Q_UNAVAILABLE_RESOURCE;
+   }
+
    LOC_LOGV("%s: Received message %p rv = %d\n", __FUNCTION__, *msg_obj, rv);
 
    return rv;
 }
 
+/*===========================================================================
+FUNCTION    msg_q_take_batch
+
+DESCRIPTION
+   Common implementation of msg_q_rcv_batch, msg_q_rcv_batch_timed and
+   msg_q_rmv_batch. A blocking take waits until deadline unless it is NULL.
+
+RETURN VALUE
+   Look at error codes above.
+
+===========================================================================*/
+static msq_q_err_type msg_q_take_batch(void* msg_q_data, void** msg_objs,
+                                       uint32_t max_count, uint32_t* count, int block,
+                                       const struct timespec* deadline)
+{
+   if( msg_q_data == NULL )
+   {
+      LOC_LOGE("%s: Invalid msg_q_data parameter!\n", __FUNCTION__);
+      return eMSG_Q_INVALID_HANDLE;
+   }
+
+   if( msg_objs == NULL || max_count == 0 || count == NULL )
+   {
+      LOC_LOGE("%s: Invalid msg_objs / max_count / count parameter!\n", __FUNCTION__);
+      return eMSG_Q_INVALID_PARAMETER;
+   }
+
+   msg_q* p_msg_q = (msg_q*)msg_q_data;
+   uint32_t n = 0;
+   *count = 0;
+
+   if( p_msg_q->engine == eMSG_Q_ENGINE_MPSC_RING )
+   {
+      if( block )
+      {
+         msq_q_err_type rv = msg_q_ring_rcv(p_msg_q, &msg_objs[0], deadline);
+         if( rv != eMSG_Q_SUCCESS )
+         {
+            return rv;
+         }
+      }
+      else if( atomic_load_explicit(&p_msg_q->ring_unblocked, memory_order_relaxed) )
+      {
+         LOC_LOGE("%s: Message queue has been unblocked.\n", __FUNCTION__);
+         return eMSG_Q_UNAVAILABLE_RESOURCE;
+      }
+      else if( !msg_q_ring_pop(p_msg_q, &msg_objs[0], NULL) )
+      {
+         return eMSG_Q_EMPTY;
+      }
+      for( n = 1; n < max_count && msg_q_ring_pop(p_msg_q, &msg_objs[n], NULL); n++ );
+      *count = n;
+      return eMSG_Q_SUCCESS;
+   }
+
+   /* nodes msg_q allocated itself, freed once list_mutex is released */
+   msg_q_node* q_alloc_nodes = NULL;
+
+   pthread_mutex_lock(&p_msg_q->list_mutex);
+
+   if( p_msg_q->unblocked )
+   {
+      LOC_LOGE("%s: Message queue has been unblocked.\n", __FUNCTION__);
+      pthread_mutex_unlock(&p_msg_q->list_mutex);
+      return eMSG_Q_UNAVAILABLE_RESOURCE;
+   }
+
+   /* Wait for data in the message queue */
+   while( block && p_msg_q->pending == 0 && !p_msg_q->unblocked )
+   {
+      if( deadline == NULL )
+      {
+         pthread_cond_wait(&p_msg_q->list_cond, &p_msg_q->list_mutex);
+      }
+      else if( pthread_cond_timedwait(&p_msg_q->list_cond, &p_msg_q->list_mutex,
+                                      deadline) == ETIMEDOUT )
+      {
+         break;
+      }
+   }
+
+   while( n < max_count )
+   {
+      msg_q_node* node = msg_q_list_remove(p_msg_q);
+      if( node == NULL )
+      {
+         break;
+      }
+      msg_objs[n++] = node->msg_obj;
+      if( node->q_alloc )
+      {
+         node->next = q_alloc_nodes;
+         q_alloc_nodes = node;
+      }
+   }
+
+   pthread_mutex_unlock(&p_msg_q->list_mutex);
+
+   while( q_alloc_nodes != NULL )
+   {
+      msg_q_node* next = q_alloc_nodes->next;
+      msg_q_node_release(q_alloc_nodes, 0);
+      q_alloc_nodes = next;
+   }
+
+   *count = n;
+
+   LOC_LOGV("%s: Received %u messages\n", __FUNCTION__, n);
+
+   if( n > 0 )
+   {
+      return eMSG_Q_SUCCESS;
+   }
+   return (block && (deadline == NULL || p_msg_q->unblocked)) ?
+          eMSG_Q_UNAVAILABLE_RESOURCE : eMSG_Q_EMPTY;
+}
+
+/*===========================================================================
+
+  FUNCTION:   msg_q_rcv_batch
+
+  ===========================================================================*/
+msq_q_err_type msg_q_rcv_batch(void* msg_q_data, void** msg_objs,
+                               uint32_t max_count, uint32_t* count)
+{
+   return msg_q_take_batch(msg_q_data, msg_objs, max_count, count, 1, NULL);
+}
+
+/*===========================================================================
+
+  FUNCTION:   msg_q_rcv_batch_timed
+
+  ===========================================================================*/
+msq_q_err_type msg_q_rcv_batch_timed(void* msg_q_data, void** msg_objs,
+                                     uint32_t max_count, uint32_t* count,
+                                     const struct timespec* deadline)
+{
+   return msg_q_take_batch(msg_q_data, msg_objs, max_count, count, 1, deadline);
+}
+
+/*===========================================================================
+
+  FUNCTION:   msg_q_rmv_batch
+
+  ===========================================================================*/
+msq_q_err_type msg_q_rmv_batch(void* msg_q_data, void** msg_objs,
+                               uint32_t max_count, uint32_t* count)
+{
+   return msg_q_take_batch(msg_q_data, msg_objs, max_count, count, 0, NULL);
+}
+
 /*===========================================================================
 
   FUNCTION:   msg_q_rmv
@@ -289,6 +1147,18 @@ msq_q_err_type msg_q_rmv(void* msg_q_data, void** msg_obj)
 
    msg_q* p_msg_q = (msg_q*)msg_q_data;
 
+   if (p_msg_q->engine == eMSG_Q_ENGINE_MPSC_RING) {
+      if (atomic_load_explicit(&p_msg_q->ring_unblocked, memory_order_relaxed)) {
+         LOC_LOGE("%s: Message queue has been unblocked.\n", __FUNCTION__);
+         return eMSG_Q_UNAVAILABLE_RESOURCE;
+      }
+      if (!msg_q_ring_pop(p_msg_q, msg_obj, NULL)) {
+         LOC_LOGW("%s: list is empty !!\n", __FUNCTION__);
+         return eMSG_Q_EMPTY;
+      }
+      return eMSG_Q_SUCCESS;
+   }
+
    pthread_mutex_lock(&p_msg_q->list_mutex);
 
    if (p_msg_q->unblocked) {
@@ -297,16 +1167,19 @@ msq_q_err_type msg_q_rmv(void* msg_q_data, void** msg_obj)
       return eMSG_Q_UNAVAILABLE_RESOURCE;
    }
 
-   if (linked_list_empty(p_msg_q->msg_list)) {
+   msg_q_node* node = msg_q_list_remove(p_msg_q);
+   if (node == NULL) {
       LOC_LOGW("%s: list is empty !!\n", __FUNCTION__);
       pthread_mutex_unlock(&p_msg_q->list_mutex);
       return eMSG_Q_EMPTY;
    }
 
-   rv = convert_linked_list_err_type(linked_list_remove(p_msg_q->msg_list, msg_obj));
-
    pthread_mutex_unlock(&p_msg_q->list_mutex);
 
+   *msg_obj = node->msg_obj;
+   msg_q_node_release(node, 0);
+   rv = eMSG_Q_SUCCESS;
+
    LOC_LOGV("%s: Removed message %p rv = %d\n", __FUNCTION__, *msg_obj, rv);
 
    return rv;
@@ -321,7 +1194,6 @@ msq_q_err_type msg_q_rmv(void* msg_q_data, void** msg_obj)
   ===========================================================================*/
 msq_q_err_type msg_q_flush(void* msg_q_data)
 {
-   msq_q_err_type rv;
    if ( msg_q_data == NULL )
    {
       LOC_LOGE("%s: Invalid msg_q_data parameter!\n", __FUNCTION__);
@@ -332,18 +1204,174 @@ msq_q_err_type msg_q_flush(void* msg_q_data)
 
    LOC_LOGD("%s: Flushing Message Queue\n", __FUNCTION__);
 
+   if( p_msg_q->engine == eMSG_Q_ENGINE_MPSC_RING )
+   {
+      msg_q_ring_flush(p_msg_q);
+      LOC_LOGD("%s: Message Queue flushed\n", __FUNCTION__);
+      return eMSG_Q_SUCCESS;
+   }
+
    pthread_mutex_lock(&p_msg_q->list_mutex);
 
-   /* Remove all elements from the list */
-   rv = convert_linked_list_err_type(linked_list_flush(p_msg_q->msg_list));
+   /* Detach all elements from all lanes into one chain */
+   msg_q_node* node = NULL;
+   msg_q_node* chain_tail = NULL;
+   uint32_t i;
+   for( i = 0; i < p_msg_q->num_lanes; i++ )
+   {
+      msg_q_lane* lane = &p_msg_q->lanes[i];
+      if( lane->head != NULL )
+      {
+         if( chain_tail != NULL )
+         {
+            chain_tail->next = lane->head;
+         }
+         else
+         {
+            node = lane->head;
+         }
+         chain_tail = lane->tail;
+      }
+      lane->head = NULL;
+      lane->tail = NULL;
+      lane->depth = 0;
+      lane->skipped = 0;
+   }
+   p_msg_q->pending = 0;
 
    pthread_mutex_unlock(&p_msg_q->list_mutex);
 
+   while( node != NULL )
+   {
+      msg_q_node* next = node->next;
+      msg_q_node_release(node, 1);
+      node = next;
+   }
+
    LOC_LOGD("%s: Message Queue flushed\n", __FUNCTION__);
 
+   return eMSG_Q_SUCCESS;
+}
+
+/*===========================================================================
+
+  FUNCTION:   msg_q_set_lanes
+
+  ===========================================================================*/
+msq_q_err_type msg_q_set_lanes(void* msg_q_data, uint32_t num_lanes,
+                               const uint32_t* max_depths, uint32_t starvation_limit)
+{
+   msq_q_err_type rv = eMSG_Q_SUCCESS;
+   uint32_t i;
+
+   if( msg_q_data == NULL )
+   {
+      LOC_LOGE("%s: Invalid msg_q_data parameter!\n", __FUNCTION__);
+      return eMSG_Q_INVALID_HANDLE;
+   }
+
+   msg_q* p_msg_q = (msg_q*)msg_q_data;
+
+   if( p_msg_q->engine != eMSG_Q_ENGINE_LINKED_LIST ||
+       num_lanes == 0 || num_lanes > MSG_Q_MAX_LANES )
+   {
+      LOC_LOGE("%s: lanes not supported, engine %d num_lanes %u\n", __FUNCTION__,
+               p_msg_q->engine, num_lanes);
+      return eMSG_Q_INVALID_PARAMETER;
+   }
+
+   pthread_mutex_lock(&p_msg_q->list_mutex);
+
+   if( p_msg_q->pending != 0 )
+   {
+      LOC_LOGE("%s: Message queue is not empty.\n", __FUNCTION__);
+      rv = eMSG_Q_FAILURE_GENERAL;
+   }
+   else
+   {
+      p_msg_q->num_lanes = num_lanes;
+      p_msg_q->starvation_limit = starvation_limit;
+      for( i = 0; i < MSG_Q_MAX_LANES; i++ )
+      {
+         p_msg_q->lanes[i].max_depth =
+               (max_depths != NULL && i < num_lanes) ? max_depths[i] : 0;
+         p_msg_q->lanes[i].skipped = 0;
+      }
+   }
+
+   pthread_mutex_unlock(&p_msg_q->list_mutex);
+
    return rv;
 }
 
+/*===========================================================================
+
+  FUNCTION:   msg_q_get_lane_stats
+
+  ===========================================================================*/
+msq_q_err_type msg_q_get_lane_stats(void* msg_q_data, uint32_t lane,
+                                    uint32_t* depth, uint64_t* dropped,
+                                    uint64_t* merged)
+{
+   if( msg_q_data == NULL )
+   {
+      LOC_LOGE("%s: Invalid msg_q_data parameter!\n", __FUNCTION__);
+      return eMSG_Q_INVALID_HANDLE;
+   }
+
+   msg_q* p_msg_q = (msg_q*)msg_q_data;
+
+   if( p_msg_q->engine != eMSG_Q_ENGINE_LINKED_LIST || lane >= p_msg_q->num_lanes ||
+       depth == NULL || dropped == NULL || merged == NULL )
+   {
+      return eMSG_Q_INVALID_PARAMETER;
+   }
+
+   pthread_mutex_lock(&p_msg_q->list_mutex);
+   *depth = p_msg_q->lanes[lane].depth;
+   *dropped = p_msg_q->lanes[lane].dropped;
+   *merged = p_msg_q->lanes[lane].merged;
+   pthread_mutex_unlock(&p_msg_q->list_mutex);
+
+   return eMSG_Q_SUCCESS;
+}
+
+/*===========================================================================
+
+  FUNCTION:   msg_q_get_depth
+
+  ===========================================================================*/
+msq_q_err_type msg_q_get_depth(void* msg_q_data, uint32_t* depth)
+{
+   if( msg_q_data == NULL )
+   {
+      LOC_LOGE("%s: Invalid msg_q_data parameter!\n", __FUNCTION__);
+      return eMSG_Q_INVALID_HANDLE;
+   }
+
+   if( depth == NULL )
+   {
+      return eMSG_Q_INVALID_PARAMETER;
+   }
+
+   msg_q* p_msg_q = (msg_q*)msg_q_data;
+
+   if( p_msg_q->engine == eMSG_Q_ENGINE_MPSC_RING )
+   {
+      /* head counts claimed slots, which may still be being written */
+      *depth = atomic_load_explicit(&p_msg_q->ring_head, memory_order_relaxed) -
+               atomic_load_explicit(&p_msg_q->ring_tail, memory_order_relaxed) +
+               atomic_load_explicit(&p_msg_q->overflow_depth, memory_order_relaxed);
+      return eMSG_Q_SUCCESS;
+   }
+
+   pthread_mutex_lock(&p_msg_q->list_mutex);
+   *depth = p_msg_q->pending;
+   pthread_mutex_unlock(&p_msg_q->list_mutex);
+
+   return eMSG_Q_SUCCESS;
+}
+
 /*===========================================================================
 
   FUNCTION:   msg_q_unblock
@@ -358,6 +1386,24 @@ msq_q_err_type msg_q_unblock(void* msg_q_data)
    }
 
    msg_q* p_msg_q = (msg_q*)msg_q_data;
+
+   if( p_msg_q->engine == eMSG_Q_ENGINE_MPSC_RING )
+   {
+      if( atomic_exchange(&p_msg_q->ring_unblocked, 1) )
+      {
+         LOC_LOGE("%s: Message queue has been unblocked.\n", __FUNCTION__);
+         return eMSG_Q_UNAVAILABLE_RESOURCE;
+      }
+
+      LOC_LOGD("%s: Unblocking Message Queue\n", __FUNCTION__);
+      /* Allow the parked consumer to wake up */
+      atomic_fetch_add(&p_msg_q->ring_futex, 1);
+      msg_q_futex_wake(&p_msg_q->ring_futex, INT_MAX);
+      LOC_LOGD("%s: Message Queue unblocked\n", __FUNCTION__);
+
+      return eMSG_Q_SUCCESS;
+   }
+
    pthread_mutex_lock(&p_msg_q->list_mutex);
 
    if( p_msg_q->unblocked )
@@ -34,6 +34,8 @@ extern "C" {
 #endif /* __cplusplus */
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
 
 /** Linked List Return Codes */
 typedef enum
@@ -54,6 +56,43 @@ typedef enum
      /**< Failed because list is empty. */
 }msq_q_err_type;
 
+/** Message Queue Engines */
+typedef enum
+{
+  eMSG_Q_ENGINE_LINKED_LIST                  = 0,
+     /**< Mutex and condition variable protected linked list, unbounded. */
+  eMSG_Q_ENGINE_MPSC_RING                    = 1
+     /**< Lock-free bounded ring, multiple producers and a single consumer.
+          The consumer is only woken up through a futex when it is parked. */
+}msg_q_engine_type;
+
+/** Intrusive message queue link. Embedding one in a message object and
+    queueing it with msg_q_snd_node saves the per message allocation
+    msg_q_snd needs with eMSG_Q_ENGINE_LINKED_LIST. */
+typedef struct msg_q_node
+{
+  struct msg_q_node* next;
+     /**< Next queued node, owned by the msg_q while the node is queued. */
+  void* msg_obj;
+     /**< Object handed out by msg_q_rcv / msg_q_rmv. */
+  void (*dealloc)(void*);
+     /**< Deallocates msg_obj during a flush operation; may be NULL. */
+  int q_alloc;
+     /**< Set by msg_q on nodes it allocated itself. */
+  uint32_t lane;
+     /**< Priority lane, see msg_q_set_lanes; 0 is the highest priority. */
+  uintptr_t coalesce_key;
+     /**< If non zero, the node replaces a still queued node of its lane with
+          the same key, which is then deallocated; 0 to always append.
+          Ignored by eMSG_Q_ENGINE_MPSC_RING. */
+}msg_q_node;
+
+/** Max number of priority lanes of a eMSG_Q_ENGINE_LINKED_LIST queue */
+#define MSG_Q_MAX_LANES 4
+
+/** Default number of slots of an eMSG_Q_ENGINE_MPSC_RING queue */
+#define MSG_Q_DEFAULT_RING_SIZE 1024
+
 /*===========================================================================
 FUNCTION    msg_q_init
 
@@ -92,6 +131,35 @@ SIDE EFFECTS
 ===========================================================================*/
 const void* msg_q_init2();
 
+/*===========================================================================
+FUNCTION    msg_q_init_engine
+
+DESCRIPTION
+   Initializes internal structures for message queue, backed by the given
+   queue engine.
+
+   msg_q_data: pointer to an opaque Q handle to be returned; NULL if fails
+   engine:     queue engine to use.
+   ring_size:  number of slots for eMSG_Q_ENGINE_MPSC_RING, rounded up to a
+               power of 2; 0 for MSG_Q_DEFAULT_RING_SIZE. Ignored by other
+               engines.
+
+DEPENDENCIES
+   eMSG_Q_ENGINE_MPSC_RING queues only support a single consumer, i.e.
+   msg_q_rcv, msg_q_rmv and msg_q_flush must be called from one thread.
+   Producers never block: while the ring is full, messages are queued on an
+   overflow list instead, which the consumer drains after the ring.
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+msq_q_err_type msg_q_init_engine(void** msg_q_data, msg_q_engine_type engine,
+                                 uint32_t ring_size);
+
 /*===========================================================================
 FUNCTION    msg_q_destroy
 
@@ -137,6 +205,30 @@ SIDE EFFECTS
 ===========================================================================*/
 msq_q_err_type msg_q_snd(void* msg_q_data, void* msg_obj, void (*dealloc)(void*));
 
+/*===========================================================================
+FUNCTION    msg_q_snd_node
+
+DESCRIPTION
+   Sends data to the message queue through an intrusive node, which is linked
+   into the queue as is; nothing is allocated internally. The node, and the
+   object it points to, must stay valid until node->msg_obj is received or
+   flushed. A node can only be queued once at a time.
+
+   msg_q_data: Message Queue to add the element to.
+   node:       Node to add, with msg_obj and dealloc set by the caller.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+msq_q_err_type msg_q_snd_node(void* msg_q_data, msg_q_node* node);
+
 /*===========================================================================
 FUNCTION    msg_q_rcv
 
@@ -159,6 +251,76 @@ SIDE EFFECTS
 ===========================================================================*/
 msq_q_err_type msg_q_rcv(void* msg_q_data, void** msg_obj);
 
+/*===========================================================================
+FUNCTION    msg_q_rcv_batch
+
+DESCRIPTION
+   Retrieves up to max_count messages from the message queue in one go.
+   Blocks like msg_q_rcv until at least one message is queued, then takes
+   whatever else is already pending (up to max_count) without waiting again.
+   Messages are handed out in the order msg_q_rcv would have returned them,
+   priority lanes included.
+
+   msg_q_data: Message Queue to copy data from.
+   msg_objs:   Array of at least max_count entries to copy msg_q contents to.
+   max_count:  Max number of messages to retrieve; must be non zero.
+   count:      Number of messages actually retrieved.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+msq_q_err_type msg_q_rcv_batch(void* msg_q_data, void** msg_objs,
+                               uint32_t max_count, uint32_t* count);
+
+/*===========================================================================
+FUNCTION    msg_q_rcv_batch_timed
+
+DESCRIPTION
+   Like msg_q_rcv_batch, but stops waiting at deadline, an absolute
+   CLOCK_MONOTONIC time. A NULL deadline waits forever.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above; eMSG_Q_EMPTY if the deadline passed with
+   no message queued.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+msq_q_err_type msg_q_rcv_batch_timed(void* msg_q_data, void** msg_objs,
+                                     uint32_t max_count, uint32_t* count,
+                                     const struct timespec* deadline);
+
+/*===========================================================================
+FUNCTION    msg_q_rmv_batch
+
+DESCRIPTION
+   Non blocking variant of msg_q_rcv_batch, takes up to max_count messages
+   that are already queued.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above; eMSG_Q_EMPTY if no message is queued.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+msq_q_err_type msg_q_rmv_batch(void* msg_q_data, void** msg_objs,
+                               uint32_t max_count, uint32_t* count);
+
 /*===========================================================================
 FUNCTION    msg_q_rmv
 
@@ -202,6 +364,76 @@ SIDE EFFECTS
 ===========================================================================*/
 msq_q_err_type msg_q_flush(void* msg_q_data);
 
+/*===========================================================================
+FUNCTION    msg_q_set_lanes
+
+DESCRIPTION
+   Splits a eMSG_Q_ENGINE_LINKED_LIST queue into priority lanes. A node sent
+   with msg_q_snd_node goes to lane node->lane (the last lane if out of
+   range), msg_q_snd always uses lane 0. Receivers are served from the
+   highest priority non empty lane, but a non empty lane is served at the
+   latest after it was skipped starvation_limit times in a row. When a lane
+   holds more than its max depth, its oldest node is dropped and deallocated.
+
+   msg_q_data:       Message queue to configure, must be empty.
+   num_lanes:        1 to MSG_Q_MAX_LANES.
+   max_depths:       num_lanes max depths, 0 for unbounded; NULL for all
+                     unbounded.
+   starvation_limit: 0 for strict priority.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+msq_q_err_type msg_q_set_lanes(void* msg_q_data, uint32_t num_lanes,
+                               const uint32_t* max_depths, uint32_t starvation_limit);
+
+/*===========================================================================
+FUNCTION    msg_q_get_lane_stats
+
+DESCRIPTION
+   Gets the current depth of a lane, the number of nodes it dropped for
+   exceeding its max depth, and the number of queued nodes that got replaced
+   by a newer node with the same coalesce_key.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+msq_q_err_type msg_q_get_lane_stats(void* msg_q_data, uint32_t lane,
+                                    uint32_t* depth, uint64_t* dropped,
+                                    uint64_t* merged);
+
+/*===========================================================================
+FUNCTION    msg_q_get_depth
+
+DESCRIPTION
+   Gets the number of messages currently queued, over all lanes.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+msq_q_err_type msg_q_get_depth(void* msg_q_data, uint32_t* depth);
+
 /*===========================================================================
 FUNCTION    msg_q_unblock
 
@@ -0,0 +1,106 @@
+/* Copyright (c) 2020 The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Host benchmark of LocHeap: push + pop, remove and update against heaps of
+// 10 to 100k nodes, the range LocTimerContainer sees.
+
+#include <LocHeap.h>
+#include <benchmark/benchmark.h>
+#include <random>
+#include <vector>
+
+using namespace loc_util;
+
+namespace {
+
+class Rank : public LocRankable {
+public:
+    uint32_t mRank;
+    inline explicit Rank(uint32_t rank = 0) : mRank(rank) {}
+    inline virtual int ranks(LocRankable& rankable) override {
+        uint32_t other = static_cast<Rank&>(rankable).mRank;
+        return (mRank > other) ? 1 : ((mRank < other) ? -1 : 0);
+    }
+};
+
+// a heap of state.range(0) nodes with random ranks, plus one spare node
+struct Fixture {
+    std::mt19937 mRng;
+    std::vector<Rank> mNodes;
+    LocHeap mHeap;
+    inline Fixture(size_t size) : mRng(size), mNodes(size + 1) {
+        for (size_t i = 0; i < size; i++) {
+            mNodes[i].mRank = mRng();
+            mHeap.push(mNodes[i]);
+        }
+        mNodes[size].mRank = mRng();
+    }
+};
+
+void BM_PushPop(benchmark::State& state) {
+    Fixture f(state.range(0));
+    Rank* spare = &f.mNodes.back();
+    for (auto _ : state) {
+        spare->mRank = f.mRng();
+        f.mHeap.push(*spare);
+        spare = (Rank*)f.mHeap.pop();
+        benchmark::DoNotOptimize(spare);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_RemovePush(benchmark::State& state) {
+    Fixture f(state.range(0));
+    size_t size = state.range(0);
+    for (auto _ : state) {
+        Rank& node = f.mNodes[f.mRng() % size];
+        benchmark::DoNotOptimize(f.mHeap.remove(node));
+        f.mHeap.push(node);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_Update(benchmark::State& state) {
+    Fixture f(state.range(0));
+    size_t size = state.range(0);
+    for (auto _ : state) {
+        Rank& node = f.mNodes[f.mRng() % size];
+        node.mRank = f.mRng();
+        benchmark::DoNotOptimize(f.mHeap.update(node));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+}
+
+BENCHMARK(BM_PushPop)->RangeMultiplier(10)->Range(10, 100000);
+BENCHMARK(BM_RemovePush)->RangeMultiplier(10)->Range(10, 100000);
+BENCHMARK(BM_Update)->RangeMultiplier(10)->Range(10, 100000);
+
+BENCHMARK_MAIN();
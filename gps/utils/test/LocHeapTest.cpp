@@ -0,0 +1,203 @@
+/* Copyright (c) 2020 The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Host test of LocHeap: every push / pop / remove / update is followed by
+// checkTree(), and the order nodes pop in is checked against their ranks.
+
+#include <LocHeap.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace loc_util;
+
+namespace {
+
+class Rank : public LocRankable {
+public:
+    int mRank;
+    inline explicit Rank(int rank = 0) : mRank(rank) {}
+    // a higher mRank ranks higher
+    inline virtual int ranks(LocRankable& rankable) override {
+        int other = static_cast<Rank&>(rankable).mRank;
+        return (mRank > other) ? 1 : ((mRank < other) ? -1 : 0);
+    }
+};
+
+// pops everything left, checking the order and the tree on the way
+void popAll(LocHeap& heap, size_t expected) {
+    size_t popped = 0;
+    int last = INT32_MAX;
+    for (Rank* node = (Rank*)heap.pop(); nullptr != node; node = (Rank*)heap.pop()) {
+        ASSERT_LE(node->mRank, last);
+        last = node->mRank;
+        ASSERT_TRUE(heap.checkTree());
+        popped++;
+    }
+    EXPECT_EQ(expected, popped);
+    EXPECT_TRUE(heap.isEmpty());
+}
+
+}
+
+TEST(LocHeapTest, EmptyHeap) {
+    LocHeap heap;
+    Rank node(1);
+    EXPECT_EQ(nullptr, heap.peek());
+    EXPECT_EQ(nullptr, heap.pop());
+    EXPECT_EQ(nullptr, heap.remove(node));
+    EXPECT_FALSE(heap.update(node));
+    EXPECT_TRUE(heap.checkTree());
+    EXPECT_EQ(0u, heap.getTreeSize());
+}
+
+TEST(LocHeapTest, PushPopInRankOrder) {
+    std::mt19937 rng(1);
+    std::vector<Rank> nodes(1000);
+    LocHeap heap;
+    for (auto& node : nodes) {
+        // duplicates on purpose
+        node.mRank = rng() % 200;
+        heap.push(node);
+        ASSERT_TRUE(heap.checkTree());
+    }
+    EXPECT_EQ(nodes.size(), heap.getTreeSize());
+    int top = std::max_element(nodes.begin(), nodes.end(), [](const Rank& a, const Rank& b) {
+        return a.mRank < b.mRank;
+    })->mRank;
+    EXPECT_EQ(top, ((Rank*)heap.peek())->mRank);
+    popAll(heap, nodes.size());
+}
+
+TEST(LocHeapTest, RemoveAnyNode) {
+    std::mt19937 rng(2);
+    std::vector<Rank> nodes(1000);
+    LocHeap heap;
+    for (auto& node : nodes) {
+        node.mRank = rng() % 10000;
+        heap.push(node);
+    }
+    std::vector<Rank*> order;
+    for (auto& node : nodes) {
+        order.push_back(&node);
+    }
+    std::shuffle(order.begin(), order.end(), rng);
+    // the top, the last node of the array and anything in between
+    order.insert(order.begin(), (Rank*)heap.peek());
+    size_t removed = 0;
+    for (size_t i = 0; i < order.size() / 2; i++) {
+        LocRankable* node = heap.remove(*order[i]);
+        if (nullptr == node) {
+            // the top got in twice
+            continue;
+        }
+        ASSERT_EQ(order[i], node);
+        ASSERT_TRUE(heap.checkTree());
+        // no longer in the heap
+        ASSERT_EQ(nullptr, heap.remove(*order[i]));
+        ASSERT_FALSE(heap.update(*order[i]));
+        removed++;
+    }
+    popAll(heap, nodes.size() - removed);
+}
+
+TEST(LocHeapTest, RemoveFromOtherHeap) {
+    LocHeap heap1;
+    LocHeap heap2;
+    Rank a(1);
+    Rank b(2);
+    heap1.push(a);
+    heap2.push(b);
+    EXPECT_EQ(nullptr, heap1.remove(b));
+    EXPECT_FALSE(heap1.update(b));
+    EXPECT_EQ(&a, heap1.remove(a));
+    EXPECT_EQ(&b, heap2.pop());
+}
+
+TEST(LocHeapTest, UpdateAfterRankChange) {
+    std::mt19937 rng(3);
+    std::vector<Rank> nodes(1000);
+    LocHeap heap;
+    for (auto& node : nodes) {
+        node.mRank = rng() % 10000;
+        heap.push(node);
+    }
+    for (int i = 0; i < 5000; i++) {
+        Rank& node = nodes[rng() % nodes.size()];
+        // up, down, or unchanged
+        node.mRank += (int)(rng() % 2001) - 1000;
+        ASSERT_TRUE(heap.update(node));
+        ASSERT_TRUE(heap.checkTree());
+    }
+    popAll(heap, nodes.size());
+}
+
+TEST(LocHeapTest, MixedChurn) {
+    std::mt19937 rng(4);
+    std::vector<Rank> nodes(500);
+    std::vector<bool> inHeap(nodes.size(), false);
+    size_t size = 0;
+    LocHeap heap;
+    for (int i = 0; i < 100000; i++) {
+        size_t n = rng() % nodes.size();
+        Rank& node = nodes[n];
+        switch (rng() % 4) {
+        case 0:
+            if (!inHeap[n]) {
+                node.mRank = rng() % 1000;
+                heap.push(node);
+                inHeap[n] = true;
+                size++;
+            }
+            break;
+        case 1:
+            ASSERT_EQ(inHeap[n] ? &node : nullptr, heap.remove(node));
+            if (inHeap[n]) {
+                inHeap[n] = false;
+                size--;
+            }
+            break;
+        case 2:
+            node.mRank = rng() % 1000;
+            ASSERT_EQ((bool)inHeap[n], heap.update(node));
+            break;
+        default: {
+            Rank* top = (Rank*)heap.pop();
+            if (nullptr != top) {
+                inHeap[top - nodes.data()] = false;
+                size--;
+            }
+            break;
+        }
+        }
+        ASSERT_TRUE(heap.checkTree());
+        ASSERT_EQ(size, heap.getTreeSize());
+    }
+}
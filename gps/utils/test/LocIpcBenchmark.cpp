@@ -0,0 +1,330 @@
+/* Copyright (c) 2020 The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Host benchmark of the LocIpc transports over loopback: local (unix
+// datagram), UDP, TCP and shared memory, across payload sizes and sender
+// counts.
+//
+// BM_LocIpcFlood has every sender send as fast as it can, BM_LocIpcPaced has
+// each wait for its message to arrive before sending the next one, and
+// BM_LocIpcBatch floods with LocIpc::sendBatch(), batch messages at a time,
+// over the local and UDP sockets. All report, as counters:
+//   msgs_per_s      messages received per second of wall clock time
+//   p50/p99/p999_ns one-way latency, send() call to onReceive()
+//   cpu_ns_per_msg  user + system time of the whole process per message
+//   lost            messages sent but never received, UDP may drop some
+// Run with --benchmark_format=json or --benchmark_out=<file> for output that
+// regressions can be tracked against.
+
+#include <LocIpc.h>
+#include <benchmark/benchmark.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace loc_util;
+using namespace std;
+
+namespace {
+
+enum Transport { LOCAL, UDP, TCP, SHM };
+const char* const kTransportNames[] = { "local", "udp", "tcp", "shm" };
+
+// messages per sender per benchmark iteration
+const uint32_t kFloodMsgs = 1000;
+const uint32_t kPacedMsgs = 100;
+// how long a lost message is waited for
+const auto kLossTimeout = chrono::milliseconds(100);
+
+const char kTag[4] = { 'B', 'N', 'C', 'H' };
+struct BenchHead {
+    char mTag[4];
+    uint32_t mSender;
+    uint64_t mSentNs;
+};
+
+inline uint64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+inline uint64_t cpuNs() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return ((uint64_t)usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000000ULL +
+            ((uint64_t)usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000ULL;
+}
+
+class BenchListener : public ILocIpcListener {
+    const uint32_t mSize;
+    const bool mStream;
+    // TCP hands over whatever the stream has, messages are cut out of it here
+    string mPending;
+    mutex mLock;
+    condition_variable mCond;
+    vector<uint32_t> mReceived;
+    uint64_t mTotal;
+    vector<uint64_t> mLatencies;
+
+    void onMessage(const char* data, uint64_t now) {
+        BenchHead head;
+        memcpy(&head, data, sizeof(head));
+        if (memcmp(head.mTag, kTag, sizeof(kTag)) == 0 && head.mSender < mReceived.size()) {
+            mLatencies.push_back(now - head.mSentNs);
+            mReceived[head.mSender]++;
+            mTotal++;
+        }
+    }
+public:
+    inline BenchListener(uint32_t size, uint32_t senders, bool stream) :
+            mSize(size), mStream(stream), mReceived(senders, 0), mTotal(0) {}
+    virtual void onReceive(const char* data, uint32_t len, const LocIpcRecver*) override {
+        uint64_t now = nowNs();
+        lock_guard<mutex> guard(mLock);
+        if (!mStream) {
+            if (len == mSize) {
+                onMessage(data, now);
+            }
+        } else {
+            mPending.append(data, len);
+            size_t offset = 0;
+            for (; offset + mSize <= mPending.size(); offset += mSize) {
+                onMessage(mPending.data() + offset, now);
+            }
+            mPending.erase(0, offset);
+        }
+        mCond.notify_all();
+    }
+    // waits until count messages of sender have been received, or for nothing
+    // to come in for kLossTimeout
+    void waitFor(uint32_t sender, uint32_t count) {
+        unique_lock<mutex> guard(mLock);
+        while (mReceived[sender] < count) {
+            uint32_t received = mReceived[sender];
+            if (!mCond.wait_for(guard, kLossTimeout, [&] { return mReceived[sender] != received; })) {
+                break;
+            }
+        }
+    }
+    void waitForAll(uint64_t count) {
+        unique_lock<mutex> guard(mLock);
+        while (mTotal < count) {
+            uint64_t total = mTotal;
+            if (!mCond.wait_for(guard, kLossTimeout, [&] { return mTotal != total; })) {
+                break;
+            }
+        }
+    }
+    inline uint32_t getReceived(uint32_t sender) {
+        lock_guard<mutex> guard(mLock);
+        return mReceived[sender];
+    }
+    inline uint64_t getTotal() {
+        lock_guard<mutex> guard(mLock);
+        return mTotal;
+    }
+    // to be called once the senders are done
+    inline uint64_t percentile(double p) {
+        lock_guard<mutex> guard(mLock);
+        if (mLatencies.empty()) {
+            return 0;
+        }
+        size_t n = min((size_t)(p * mLatencies.size()), mLatencies.size() - 1);
+        nth_element(mLatencies.begin(), mLatencies.begin() + n, mLatencies.end());
+        return mLatencies[n];
+    }
+};
+
+void runBenchmark(benchmark::State& state, bool paced, uint32_t batch = 1) {
+    Transport transport = (Transport)state.range(0);
+    uint32_t size = state.range(1);
+    uint32_t senders = state.range(2);
+    uint32_t msgs = paced ? kPacedMsgs : kFloodMsgs;
+    state.SetLabel(kTransportNames[transport]);
+
+    // a port or socket name of its own for every run, a TCP port just closed
+    // may not be bound again right away
+    static atomic<uint32_t> sRun(0);
+    uint32_t run = sRun++;
+    int32_t port = 29400 + (getpid() + run) % 1000;
+    string name("/tmp/loc_ipc_bench." + to_string(getpid()) + "." + to_string(run));
+
+    auto listener = make_shared<BenchListener>(size, senders, TCP == transport);
+    unique_ptr<LocIpcRecver> recver;
+    vector<shared_ptr<LocIpcSender>> ipcSenders;
+    for (uint32_t i = 0; i < senders; i++) {
+        switch (transport) {
+        case LOCAL:
+            if (0 == i) {
+                recver = LocIpc::getLocIpcLocalRecver(listener, name.c_str());
+            }
+            ipcSenders.push_back(LocIpc::getLocIpcLocalSender(name.c_str()));
+            break;
+        case UDP:
+            if (0 == i) {
+                recver = LocIpc::getLocIpcInetUdpRecver(listener, "127.0.0.1", port);
+            }
+            ipcSenders.push_back(LocIpc::getLocIpcInetUdpSender("127.0.0.1", port));
+            break;
+        case TCP:
+            // the recver takes a single connection
+            if (0 == i) {
+                recver = LocIpc::getLocIpcInetTcpRecver(listener, "127.0.0.1", port);
+                ipcSenders.push_back(LocIpc::getLocIpcInetTcpSender("127.0.0.1", port));
+            }
+            break;
+        case SHM:
+            // each sender gets a ring of its own, the default 512k takes the
+            // largest payloads
+            if (0 == i) {
+                recver = LocIpc::getLocIpcShmRecver(listener, name.c_str());
+            }
+            ipcSenders.push_back(LocIpc::getLocIpcShmSender(name.c_str()));
+            break;
+        }
+    }
+    senders = ipcSenders.size();
+    LocIpc locIpc;
+    if (nullptr == recver || !locIpc.startNonBlockingListening(recver)) {
+        state.SkipWithError("recver failed to start");
+        return;
+    }
+
+    uint64_t sent = 0;
+    uint64_t cpuStart = cpuNs();
+    for (auto _ : state) {
+        vector<thread> threads;
+        atomic<uint64_t> roundSent(0);
+        for (uint32_t i = 0; i < senders; i++) {
+            threads.emplace_back([&, i] {
+                vector<vector<uint8_t>> data(batch, vector<uint8_t>(size, 'x'));
+                vector<LocIpcSpan> spans(batch);
+                BenchHead head = { { kTag[0], kTag[1], kTag[2], kTag[3] }, i, 0 };
+                uint32_t ok = 0;
+                uint32_t count = 0;
+                for (uint32_t n = 0; n < msgs; n += count) {
+                    count = min(batch, msgs - n);
+                    for (uint32_t j = 0; j < count; j++) {
+                        head.mSentNs = nowNs();
+                        memcpy(data[j].data(), &head, sizeof(head));
+                        spans[j] = { data[j].data(), size };
+                    }
+                    uint32_t received = paced ? listener->getReceived(i) : 0;
+                    if ((1 == batch) ? LocIpc::send(*ipcSenders[i], data[0].data(), size) :
+                            LocIpc::sendBatch(*ipcSenders[i], spans.data(), count)) {
+                        ok += count;
+                        if (paced) {
+                            listener->waitFor(i, received + 1);
+                        }
+                    }
+                }
+                roundSent += ok;
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        sent += roundSent;
+        listener->waitForAll(sent);
+    }
+    uint64_t cpu = cpuNs() - cpuStart;
+
+    // closing the TCP connection ends its listening, the others are aborted
+    ipcSenders.clear();
+    locIpc.stopNonBlockingListening();
+
+    uint64_t received = listener->getTotal();
+    state.SetBytesProcessed(received * size);
+    state.counters["msgs_per_s"] = benchmark::Counter(received, benchmark::Counter::kIsRate);
+    state.counters["p50_ns"] = listener->percentile(0.5);
+    state.counters["p99_ns"] = listener->percentile(0.99);
+    state.counters["p999_ns"] = listener->percentile(0.999);
+    state.counters["cpu_ns_per_msg"] = received ? (double)cpu / received : 0;
+    // a batch that failed part way counts as not sent
+    state.counters["lost"] = (sent > received) ? sent - received : 0;
+}
+
+void BM_LocIpcFlood(benchmark::State& state) {
+    runBenchmark(state, false);
+}
+
+void BM_LocIpcPaced(benchmark::State& state) {
+    runBenchmark(state, true);
+}
+
+void BM_LocIpcBatch(benchmark::State& state) {
+    runBenchmark(state, false, state.range(3));
+}
+
+// payloads past 8k go out of the sockets in parts, which a TCP recver can not
+// put together; nor can the others when several senders interleave them, so
+// those runs count the messages as lost. Shared memory takes them whole.
+void transportArgs(benchmark::internal::Benchmark* b) {
+    b->ArgNames({ "transport", "size", "senders" });
+    for (int size : { 64, 1024, 8192, 32768, 65536 }) {
+        for (int senders : { 1, 4 }) {
+            b->Args({ LOCAL, size, senders });
+            b->Args({ UDP, size, senders });
+            b->Args({ SHM, size, senders });
+        }
+        if (size <= 8192) {
+            b->Args({ TCP, size, 1 });
+        }
+    }
+}
+
+}
+
+BENCHMARK(BM_LocIpcFlood)->Apply(transportArgs)->UseRealTime();
+BENCHMARK(BM_LocIpcPaced)->Apply(transportArgs)->UseRealTime();
+BENCHMARK(BM_LocIpcBatch)
+        ->ArgNames({ "transport", "size", "senders", "batch" })
+        ->ArgsProduct({ { LOCAL, UDP }, { 64, 1024 }, { 1 }, { 8, 32 } })
+        ->UseRealTime();
+
+int main(int argc, char** argv) {
+    // aborting a TCP recver writes to its listening socket
+    signal(SIGPIPE, SIG_IGN);
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
@@ -0,0 +1,118 @@
+/* Copyright (c) 2020 The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Host benchmark of the msg_q engines: producer threads flood one queue that
+// the benchmark thread drains, as the adapter threads' MsgTask does, one
+// message at a time with msg_q_rcv (BM_MsgQ) or up to batch at a time with
+// msg_q_rcv_batch (BM_MsgQBatch). Reports msgs_per_s and the voluntary
+// context switches per message, a measure of the futex waits and wakeups.
+
+#include <msg_q.h>
+#include <benchmark/benchmark.h>
+#include <sys/resource.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// messages per producer per benchmark iteration
+const uint32_t kMsgs = 10000;
+const char* const kEngineNames[] = { "linked_list", "mpsc_ring" };
+
+inline uint64_t contextSwitches() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_nvcsw;
+}
+
+void runMsgQ(benchmark::State& state, uint32_t batch) {
+    msg_q_engine_type engine = (msg_q_engine_type)state.range(0);
+    uint32_t producers = state.range(1);
+    state.SetLabel(kEngineNames[engine]);
+    void* q = nullptr;
+    if (eMSG_Q_SUCCESS != msg_q_init_engine(&q, engine, 0)) {
+        state.SkipWithError("msg_q_init_engine failed");
+        return;
+    }
+
+    uint64_t received = 0;
+    uint64_t switches = contextSwitches();
+    for (auto _ : state) {
+        std::vector<std::thread> threads;
+        for (uint32_t i = 0; i < producers; i++) {
+            threads.emplace_back([q] {
+                static int msg;
+                for (uint32_t n = 0; n < kMsgs; n++) {
+                    msg_q_snd(q, &msg, nullptr);
+                }
+            });
+        }
+        std::vector<void*> msgs(batch);
+        uint32_t count = 1;
+        for (uint32_t n = 0; n < producers * kMsgs; n += count) {
+            if (1 == batch) {
+                msg_q_rcv(q, &msgs[0]);
+            } else {
+                msg_q_rcv_batch(q, msgs.data(), std::min(batch, producers * kMsgs - n), &count);
+            }
+        }
+        received += producers * kMsgs;
+        for (auto& t : threads) {
+            t.join();
+        }
+    }
+    switches = contextSwitches() - switches;
+    msg_q_destroy(&q);
+
+    state.counters["msgs_per_s"] = benchmark::Counter(received, benchmark::Counter::kIsRate);
+    state.counters["ctx_switches_per_msg"] = received ? (double)switches / received : 0;
+}
+
+void BM_MsgQ(benchmark::State& state) {
+    runMsgQ(state, 1);
+}
+
+void BM_MsgQBatch(benchmark::State& state) {
+    runMsgQ(state, state.range(2));
+}
+
+}
+
+BENCHMARK(BM_MsgQ)
+        ->ArgNames({ "engine", "producers" })
+        ->ArgsProduct({ { eMSG_Q_ENGINE_LINKED_LIST, eMSG_Q_ENGINE_MPSC_RING }, { 1, 2, 4, 8 } })
+        ->UseRealTime();
+BENCHMARK(BM_MsgQBatch)
+        ->ArgNames({ "engine", "producers", "batch" })
+        ->ArgsProduct({ { eMSG_Q_ENGINE_LINKED_LIST, eMSG_Q_ENGINE_MPSC_RING }, { 1, 4 },
+                        { 16, 64 } })
+        ->UseRealTime();
+
+BENCHMARK_MAIN();
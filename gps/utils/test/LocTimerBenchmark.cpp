@@ -0,0 +1,129 @@
+/* Copyright (c) 2020 The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Host benchmark of the two LocTimerContainer backends, LocHeap (default) and
+// LocTimingWheel (TIMER_CONTAINER=1 in gps.conf), with 10, 1k and 100k timers
+// running. The timers stand in for LocTimerDelegates: both a LocRankable and
+// a LocWheelNode, ranked by their due time in ms.
+//   StartStop: a random timer is stopped, then started again
+//   Expire:    the soonest timer expires and is started again, as a periodic
+//              timer would be
+
+#include <LocHeap.h>
+#include <LocTimingWheel.h>
+#include <benchmark/benchmark.h>
+#include <random>
+#include <vector>
+
+using namespace loc_util;
+
+namespace {
+
+// timers are due up to a minute out
+const uint32_t kMaxDelayMs = 60000;
+
+class Timer : public LocRankable, public LocWheelNode {
+public:
+    uint64_t mDueMs;
+    inline Timer() : mDueMs(0) {}
+    // the sooner due, the higher the rank
+    inline virtual int ranks(LocRankable& rankable) override {
+        uint64_t other = static_cast<Timer&>(rankable).mDueMs;
+        return (mDueMs < other) ? 1 : ((mDueMs > other) ? -1 : 0);
+    }
+};
+
+struct HeapTimers {
+    LocHeap mHeap;
+    inline HeapTimers(uint64_t) {}
+    inline void start(Timer& timer, uint64_t dueMs) {
+        timer.mDueMs = dueMs;
+        mHeap.push(timer);
+    }
+    inline void stop(Timer& timer) { mHeap.remove(timer); }
+    inline Timer* expire() { return static_cast<Timer*>(mHeap.pop()); }
+};
+
+struct WheelTimers {
+    LocTimingWheel mWheel;
+    inline WheelTimers(uint64_t nowMs) : mWheel(nowMs) {}
+    inline void start(Timer& timer, uint64_t dueMs) {
+        timer.mDueMs = dueMs;
+        mWheel.add(timer, dueMs);
+    }
+    inline void stop(Timer& timer) { mWheel.remove(timer); }
+    // as the container does: the clock moves on to when the soonest is due
+    inline Timer* expire() {
+        LocWheelNode* soonest = mWheel.peek();
+        return (nullptr == soonest) ? nullptr :
+                static_cast<Timer*>(mWheel.popDue(soonest->getTick()));
+    }
+};
+
+template <typename Timers>
+struct Fixture {
+    std::mt19937 mRng;
+    std::vector<Timer> mTimers;
+    Timers mContainer;
+    inline Fixture(size_t count) : mRng(count), mTimers(count), mContainer(0) {
+        for (auto& timer : mTimers) {
+            mContainer.start(timer, 1 + mRng() % kMaxDelayMs);
+        }
+    }
+};
+
+template <typename Timers>
+void BM_StartStop(benchmark::State& state) {
+    Fixture<Timers> f(state.range(0));
+    for (auto _ : state) {
+        Timer& timer = f.mTimers[f.mRng() % f.mTimers.size()];
+        f.mContainer.stop(timer);
+        f.mContainer.start(timer, 1 + f.mRng() % kMaxDelayMs);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+template <typename Timers>
+void BM_Expire(benchmark::State& state) {
+    Fixture<Timers> f(state.range(0));
+    for (auto _ : state) {
+        Timer* timer = f.mContainer.expire();
+        f.mContainer.start(*timer, timer->mDueMs + 1 + f.mRng() % kMaxDelayMs);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+}
+
+BENCHMARK_TEMPLATE(BM_StartStop, HeapTimers)->Arg(10)->Arg(1000)->Arg(100000);
+BENCHMARK_TEMPLATE(BM_StartStop, WheelTimers)->Arg(10)->Arg(1000)->Arg(100000);
+BENCHMARK_TEMPLATE(BM_Expire, HeapTimers)->Arg(10)->Arg(1000)->Arg(100000);
+BENCHMARK_TEMPLATE(BM_Expire, WheelTimers)->Arg(10)->Arg(1000)->Arg(100000);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,210 @@
+/* Copyright (c) 2020 The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Host benchmarks of MsgTask.
+//
+// BM_SendMsg: posting callables to a MsgTask, sendMsg(std::function),
+// which allocates a RunMsg and, past small captures, the function's state,
+// against sendMsg(F&&), which keeps captures of up to
+// LocCallMsg::kCaptureSize inline in a pooled LocCallMsg. Each iteration
+// posts a burst of msgs and waits for the MsgTask thread to run them all;
+// bursts deeper than the pool of LocCallMsgs allocate for the excess.
+// Reports msgs_per_s and the heap allocations per msg.
+//
+// BM_CommandLatency: how long a command waits behind a flood of reports, in a
+// plain FIFO MsgTask and with priority lanes as gps.conf enables them. A
+// thread keeps a backlog of reports queued, each taking 1us to process, while
+// the benchmark thread sends commands one at a time. Reports the p50, p99
+// and max latency of the commands, send to proc().
+
+#include <MsgTask.h>
+#include <benchmark/benchmark.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace {
+std::atomic<uint64_t> sAllocs(0);
+}
+
+void* operator new(size_t size) {
+    sAllocs.fetch_add(1, std::memory_order_relaxed);
+    void* p = malloc(size);
+    if (nullptr == p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+using namespace loc_util;
+
+namespace {
+
+// what a typical adapter lambda captures: this, and a small report
+template <size_t N>
+struct Capture {
+    std::atomic<uint64_t>* mProcessed;
+    char mReport[N];
+};
+
+template <size_t N, bool function>
+void BM_SendMsg(benchmark::State& state) {
+    uint32_t burst = state.range(0);
+    MsgTask task("bench");
+    std::atomic<uint64_t> processed(0);
+    Capture<N> capture;
+    capture.mProcessed = &processed;
+    memset(capture.mReport, 0, sizeof(capture.mReport));
+
+    uint64_t posted = 0;
+    uint64_t allocs = sAllocs.load();
+    for (auto _ : state) {
+        for (uint32_t i = 0; i < burst; i++) {
+            auto callable = [capture] () {
+                benchmark::DoNotOptimize(capture.mReport);
+                capture.mProcessed->fetch_add(1, std::memory_order_relaxed);
+            };
+            if (function) {
+                task.sendMsg(std::function<void()>(callable));
+            } else {
+                task.sendMsg(std::move(callable));
+            }
+        }
+        posted += burst;
+        while (processed.load(std::memory_order_relaxed) < posted) {
+            std::this_thread::yield();
+        }
+    }
+    allocs = sAllocs.load() - allocs;
+
+    state.counters["msgs_per_s"] = benchmark::Counter(posted, benchmark::Counter::kIsRate);
+    state.counters["allocs_per_msg"] = posted ? (double)allocs / posted : 0;
+}
+
+inline uint64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// reports queued at any time
+const uint64_t kBacklog = 500;
+
+struct ReportMsg : public LocMsg {
+    std::atomic<uint64_t>& mProcessed;
+    inline ReportMsg(std::atomic<uint64_t>& processed) : mProcessed(processed) {}
+    inline virtual void proc() const override {
+        uint64_t start = nowNs();
+        while (nowNs() - start < 1000);
+        mProcessed.fetch_add(1, std::memory_order_relaxed);
+    }
+    inline virtual LocMsgLane getLane() const override { return LOC_MSG_LANE_BULK; }
+};
+
+struct CommandMsg : public LocMsg {
+    const uint64_t mSentNs;
+    std::atomic<uint64_t>& mLatencyNs;
+    inline CommandMsg(std::atomic<uint64_t>& latencyNs) :
+            mSentNs(nowNs()), mLatencyNs(latencyNs) {}
+    inline virtual void proc() const override {
+        mLatencyNs.store(nowNs() - mSentNs, std::memory_order_release);
+    }
+};
+
+void BM_CommandLatency(benchmark::State& state) {
+    bool lanes = state.range(0);
+    std::atomic<uint64_t> processed(0);
+    std::atomic<uint64_t> latencyNs(0);
+    std::atomic<bool> stop(false);
+    MsgTask task("bench");
+    if (lanes) {
+        // MSG_Q_*_LANE_DEPTH and MSG_Q_STARVATION_LIMIT defaults of gps.conf
+        uint32_t depths[LOC_MSG_LANE_MAX] = {};
+        task.enablePriorityLanes(depths, 16);
+    }
+
+    std::thread flood([&] {
+        uint64_t posted = 0;
+        while (!stop.load(std::memory_order_relaxed)) {
+            if (posted - processed.load(std::memory_order_relaxed) < kBacklog) {
+                task.sendMsg(new ReportMsg(processed));
+                posted++;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+    // a backlog to start with
+    while (processed.load() == 0) {
+        std::this_thread::yield();
+    }
+
+    std::vector<uint64_t> latencies;
+    for (auto _ : state) {
+        latencyNs.store(0);
+        task.sendMsg(new CommandMsg(latencyNs));
+        while (0 == latencyNs.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+        latencies.push_back(latencyNs.load());
+    }
+    stop = true;
+    flood.join();
+
+    std::sort(latencies.begin(), latencies.end());
+    if (!latencies.empty()) {
+        size_t n = latencies.size();
+        state.counters["p50_ns"] = latencies[n / 2];
+        state.counters["p99_ns"] = latencies[std::min(n - 1, n * 99 / 100)];
+        state.counters["max_ns"] = latencies.back();
+    }
+}
+
+}
+
+// captures of 16, 40 and 136 bytes: small enough for std::function to keep
+// inline, within LocCallMsg::kCaptureSize only, and past both
+BENCHMARK_TEMPLATE(BM_SendMsg, 8, true)->ArgName("burst")->Arg(16)->Arg(256)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_SendMsg, 8, false)->ArgName("burst")->Arg(16)->Arg(256)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_SendMsg, 32, true)->ArgName("burst")->Arg(16)->Arg(256)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_SendMsg, 32, false)->ArgName("burst")->Arg(16)->Arg(256)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_SendMsg, 128, true)->ArgName("burst")->Arg(16)->Arg(256)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_SendMsg, 128, false)->ArgName("burst")->Arg(16)->Arg(256)->UseRealTime();
+
+BENCHMARK(BM_CommandLatency)->ArgName("lanes")->Arg(0)->Arg(1)->UseRealTime();
+
+BENCHMARK_MAIN();